@@ -0,0 +1,430 @@
+/*
+ * Xlib Display Backend
+ * The production implementation of the Backend interface
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#ifdef XRES
+#include <X11/extensions/XRes.h>
+#endif
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
+#include "swm.h"
+
+const Backend *be = &xlib_backend;
+
+#ifdef XCB
+#define PREFETCH_MAX    16
+
+typedef struct {
+    PropertyRequest req;
+    xcb_get_property_reply_t *reply;    /* NULL after an error */
+} Prefetched;
+
+static Prefetched prefetched[PREFETCH_MAX];
+static int num_prefetched;
+static Window prefetched_win;
+#endif
+
+static Bool xlib_open(void) {
+    if (!(dpy = XOpenDisplay(NULL))) {
+        return False;
+    }
+    /* Keep the X connection out of everything swm launches */
+    fcntl(ConnectionNumber(dpy), F_SETFD, FD_CLOEXEC);
+    screen = DefaultScreen(dpy);
+    root = RootWindow(dpy, screen);
+    screen_width = DisplayWidth(dpy, screen);
+    screen_height = DisplayHeight(dpy, screen);
+    return True;
+}
+
+static void xlib_close(void) {
+    XCloseDisplay(dpy);
+    dpy = NULL;
+}
+
+/* Blocking round trips are traced with the sequence number they wait on */
+static Bool xlib_get_attributes(Window win, XWindowAttributes *wa) {
+    Bool ok;
+
+    trace_begin("XGetWindowAttributes", "roundtrip");
+    ok = XGetWindowAttributes(dpy, win, wa) != 0;
+    trace_end();
+    return ok;
+}
+
+static void xlib_select_input(Window win, long mask) {
+    XSelectInput(dpy, win, mask);
+}
+
+static void xlib_move_resize(Window win, int x, int y, int width, int height) {
+    XMoveResizeWindow(dpy, win, x, y, width, height);
+}
+
+static void xlib_configure(Window win, unsigned int mask, XWindowChanges *wc) {
+    XConfigureWindow(dpy, win, mask, wc);
+}
+
+static void xlib_map(Window win) {
+    XMapWindow(dpy, win);
+}
+
+static void xlib_unmap(Window win) {
+    XUnmapWindow(dpy, win);
+}
+
+static void xlib_raise(Window win) {
+    XRaiseWindow(dpy, win);
+}
+
+static void xlib_restack(Window *wins, int n) {
+    XRestackWindows(dpy, wins, n);
+}
+
+static void xlib_set_border_width(Window win, unsigned int width) {
+    XSetWindowBorderWidth(dpy, win, width);
+}
+
+static void xlib_set_border(Window win, unsigned long pixel) {
+    XSetWindowBorder(dpy, win, pixel);
+}
+
+static void xlib_set_focus(Window win) {
+    XSetInputFocus(dpy, win, RevertToPointerRoot, CurrentTime);
+}
+
+#ifdef XCB
+/* Hand out a prefetched reply the way XGetWindowProperty would: 32-bit
+ * items sign-extended to long as _XRead32 does, and a NUL after the data */
+static int take_prefetched(Prefetched *p, Atom *actual_type, int *format,
+                           unsigned long *nitems, unsigned char **data) {
+    xcb_get_property_reply_t *r = p->reply;
+    unsigned char *value;
+    unsigned long n;
+    size_t size;
+
+    *actual_type = None;
+    *format = 0;
+    *nitems = 0;
+    *data = NULL;
+    p->req.prop = None;
+    p->reply = NULL;
+    if (!r) {
+        return BadWindow;
+    }
+    if (r->type == None || (r->format != 8 && r->format != 16 && r->format != 32)) {
+        free(r);
+        return Success;
+    }
+    value = xcb_get_property_value(r);
+    n = xcb_get_property_value_length(r) / (r->format / 8);
+    size = n * (r->format == 32 ? sizeof(long) : r->format == 16 ? sizeof(short) : 1);
+    if ((*data = malloc(size + 1))) {
+        for (unsigned long i = 0; i < n; i++) {
+            if (r->format == 32) {
+                ((long *)*data)[i] = ((int32_t *)value)[i];
+            } else if (r->format == 16) {
+                ((short *)*data)[i] = ((uint16_t *)value)[i];
+            } else {
+                (*data)[i] = value[i];
+            }
+        }
+        (*data)[size] = '\0';
+        *actual_type = r->type;
+        *format = r->format;
+        *nitems = n;
+    }
+    free(r);
+    return Success;
+}
+#endif
+
+static int xlib_get_property(Window win, Atom prop, Atom type, long length,
+                             Atom *actual_type, int *format,
+                             unsigned long *nitems, unsigned char **data) {
+    unsigned long bytes_after;
+    int status;
+
+#ifdef XCB
+    for (int i = 0; win == prefetched_win && i < num_prefetched; i++) {
+        Prefetched *p = &prefetched[i];
+        if (p->req.prop == prop && p->req.type == type && p->req.length == length) {
+            return take_prefetched(p, actual_type, format, nitems, data);
+        }
+    }
+#endif
+    trace_begin("XGetWindowProperty", "roundtrip");
+    status = XGetWindowProperty(dpy, win, prop, 0, length, False, type,
+                                actual_type, format, nitems, &bytes_after, data);
+    trace_end();
+    return status;
+}
+
+/* XCB lets all the GetProperty requests go out before the first reply is
+ * waited for; plain Xlib reads them one round trip at a time */
+static void xlib_prefetch_properties(Window win, const PropertyRequest *req, int n) {
+#ifdef XCB
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+    xcb_get_property_cookie_t cookies[PREFETCH_MAX];
+
+    for (int i = 0; i < num_prefetched; i++) {
+        free(prefetched[i].reply);
+    }
+    num_prefetched = 0;
+    prefetched_win = None;
+    if (n > PREFETCH_MAX) {
+        n = PREFETCH_MAX;
+    }
+    if (!n) {
+        return;
+    }
+    trace_begin("xcb_get_property", "roundtrip");
+    for (int i = 0; i < n; i++) {
+        cookies[i] = xcb_get_property(conn, 0, win, req[i].prop, req[i].type,
+                                      0, req[i].length);
+    }
+    for (int i = 0; i < n; i++) {
+        xcb_generic_error_t *error = NULL;
+
+        prefetched[i].req = req[i];
+        prefetched[i].reply = xcb_get_property_reply(conn, cookies[i], &error);
+        free(error);
+    }
+    trace_end();
+    num_prefetched = n;
+    prefetched_win = win;
+#else
+    (void)win;
+    (void)req;
+    (void)n;
+#endif
+}
+
+static void xlib_change_property(Window win, Atom prop, Atom type, int format,
+                                 int mode, const unsigned char *data, int n) {
+    XChangeProperty(dpy, win, prop, type, format, mode, data, n);
+}
+
+static void xlib_send_event(Window win, long mask, XEvent *ev) {
+    XSendEvent(dpy, win, False, mask, ev);
+}
+
+static Atom xlib_intern_atom(const char *name) {
+    Atom atom;
+
+    trace_begin("XInternAtom", "roundtrip");
+    atom = XInternAtom(dpy, name, False);
+    trace_end();
+    return atom;
+}
+
+static Window xlib_create_window(Window parent, int x, int y, int width,
+                                 int height, unsigned long mask,
+                                 XSetWindowAttributes *wa) {
+    return XCreateWindow(dpy, parent, x, y, width, height, 0,
+                         DefaultDepth(dpy, screen), CopyFromParent,
+                         DefaultVisual(dpy, screen), mask, wa);
+}
+
+static void xlib_destroy_window(Window win) {
+    XDestroyWindow(dpy, win);
+}
+
+static void xlib_reparent(Window win, Window parent, int x, int y) {
+    XReparentWindow(dpy, win, parent, x, y);
+}
+
+static Window xlib_get_selection_owner(Atom selection) {
+    Window owner;
+
+    trace_begin("XGetSelectionOwner", "roundtrip");
+    owner = XGetSelectionOwner(dpy, selection);
+    trace_end();
+    return owner;
+}
+
+static void xlib_set_selection_owner(Atom selection, Window owner) {
+    XSetSelectionOwner(dpy, selection, owner, CurrentTime);
+}
+
+static Bool xlib_query_tree(Window win, Window **children, unsigned int *n) {
+    Window d1, d2;
+    Bool ok;
+
+    trace_begin("XQueryTree", "roundtrip");
+    ok = XQueryTree(dpy, win, &d1, &d2, children, n) != 0;
+    trace_end();
+    return ok;
+}
+
+static void xlib_grab_key(KeySym keysym, unsigned int mod) {
+    KeyCode code = XKeysymToKeycode(dpy, keysym);
+
+    if (code) {
+        XGrabKey(dpy, code, mod, root, True, GrabModeAsync, GrabModeAsync);
+    }
+}
+
+static void xlib_ungrab_keys(void) {
+    XUngrabKey(dpy, AnyKey, AnyModifier, root);
+}
+
+static Bool xlib_grab_keyboard(void) {
+    Window d1, d2;
+    int d3, d4, d5, d6;
+    unsigned int mask;
+    int status;
+    
+    trace_begin("XGrabKeyboard", "roundtrip");
+    status = XGrabKeyboard(dpy, root, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+    trace_end();
+    if (status != GrabSuccess) {
+        return False;
+    }
+    /* The release may have happened before the grab took effect */
+    trace_begin("XQueryPointer", "roundtrip");
+    XQueryPointer(dpy, root, &d1, &d2, &d3, &d4, &d5, &d6, &mask);
+    trace_end();
+    if (!(mask & (ShiftMask | ControlMask | Mod1Mask | Mod3Mask | Mod4Mask | Mod5Mask))) {
+        XUngrabKeyboard(dpy, CurrentTime);
+        return False;
+    }
+    return True;
+}
+
+static void xlib_ungrab_keyboard(void) {
+    XUngrabKeyboard(dpy, CurrentTime);
+}
+
+static KeySym xlib_lookup_keysym(XKeyEvent *ev) {
+    return XLookupKeysym(ev, 0);
+}
+
+static void xlib_kill(Window win) {
+    XKillClient(dpy, win);
+}
+
+/* The PID the server sees on the window owner's connection; local
+ * clients only, and only with the X-Resource extension */
+static pid_t xlib_client_pid(Window win) {
+    pid_t pid = 0;
+#ifdef XRES
+    XResClientIdSpec spec = { win, XRES_CLIENT_ID_PID_MASK };
+    XResClientIdValue *ids = NULL;
+    long num = 0;
+
+    trace_begin("XResQueryClientIds", "roundtrip");
+    if (XResQueryClientIds(dpy, 1, &spec, &num, &ids) == Success) {
+        for (long i = 0; i < num && pid <= 0; i++) {
+            pid = XResGetClientPid(&ids[i]);
+        }
+        XResClientIdsDestroy(num, ids);
+    }
+    trace_end();
+#else
+    (void)win;
+#endif
+    return pid > 0 ? pid : 0;
+}
+
+/* Resources of the client owning win, counted over all types, and the
+ * bytes of its pixmaps */
+static Bool xlib_client_resources(Window win, unsigned long *count,
+                                  unsigned long *pixmap_bytes) {
+    Bool ok = False;
+#ifdef XRES
+    XResType *types = NULL;
+    int num = 0;
+
+    trace_begin("XResQueryClientResources", "roundtrip");
+    if (XResQueryClientResources(dpy, win, &num, &types) &&
+        XResQueryClientPixmapBytes(dpy, win, pixmap_bytes)) {
+        *count = 0;
+        for (int i = 0; i < num; i++) {
+            *count += types[i].count;
+        }
+        ok = True;
+    }
+    if (types) {
+        XFree(types);
+    }
+    trace_end();
+#else
+    (void)win;
+    (void)count;
+    (void)pixmap_bytes;
+#endif
+    return ok;
+}
+
+static unsigned long xlib_alloc_color(const char *name) {
+    Colormap cmap = DefaultColormap(dpy, screen);
+    XColor xcolor;
+
+    Status ok;
+
+    trace_begin("XAllocNamedColor", "roundtrip");
+    ok = XAllocNamedColor(dpy, cmap, name, &xcolor, &xcolor);
+    trace_end();
+    if (!ok) {
+        die("Cannot allocate color");
+    }
+    return xcolor.pixel;
+}
+
+static void xlib_sync(void) {
+    trace_begin("XSync", "roundtrip");
+    XSync(dpy, False);
+    trace_end();
+}
+
+static unsigned long xlib_requests(void) {
+    return XNextRequest(dpy);
+}
+
+const Backend xlib_backend = {
+    .name = "xlib",
+    .open = xlib_open,
+    .close = xlib_close,
+    .get_attributes = xlib_get_attributes,
+    .select_input = xlib_select_input,
+    .move_resize = xlib_move_resize,
+    .configure = xlib_configure,
+    .map = xlib_map,
+    .unmap = xlib_unmap,
+    .raise = xlib_raise,
+    .restack = xlib_restack,
+    .set_border_width = xlib_set_border_width,
+    .set_border = xlib_set_border,
+    .set_focus = xlib_set_focus,
+    .get_property = xlib_get_property,
+    .prefetch_properties = xlib_prefetch_properties,
+    .change_property = xlib_change_property,
+    .send_event = xlib_send_event,
+    .intern_atom = xlib_intern_atom,
+    .create_window = xlib_create_window,
+    .destroy_window = xlib_destroy_window,
+    .reparent = xlib_reparent,
+    .get_selection_owner = xlib_get_selection_owner,
+    .set_selection_owner = xlib_set_selection_owner,
+    .query_tree = xlib_query_tree,
+    .grab_key = xlib_grab_key,
+    .ungrab_keys = xlib_ungrab_keys,
+    .grab_keyboard = xlib_grab_keyboard,
+    .ungrab_keyboard = xlib_ungrab_keyboard,
+    .lookup_keysym = xlib_lookup_keysym,
+    .kill = xlib_kill,
+    .client_pid = xlib_client_pid,
+    .client_resources = xlib_client_resources,
+    .alloc_color = xlib_alloc_color,
+    .sync = xlib_sync,
+    .requests = xlib_requests,
+    .report = NULL,
+};
@@ -0,0 +1,412 @@
+/*
+ * Status Bar
+ *
+ * Shares the reserved strip at the bottom of the screen with the tray and
+ * shows the layout name, the focused window's title and the status
+ * modules from config.h.  Modules are refreshed by their own timerfd or
+ * by inotify on a watched file, never by polling.  Everything is drawn
+ * into a cached pixmap and only segments whose text or position changed
+ * are repainted and copied to the window.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <X11/Xlib.h>
+#include "swm.h"
+
+#define BAR_PAD         6
+#define BAR_TEXT_MAX    256
+
+/* Segment order: layout name, window title, then one per module */
+enum { SegLayout, SegTitle, SegModules };
+
+typedef struct {
+    char text[BAR_TEXT_MAX];
+    int x, w;
+    bool dirty;
+} Segment;
+
+typedef struct {
+    int index;
+    char buf[BAR_TEXT_MAX];     /* written by a worker while busy */
+    bool busy, again;
+    int timer_fd;
+    int watch_wd;
+    const char *watch_name;
+    char watch_path[BAR_TEXT_MAX];
+} ModuleState;
+
+static Window bar_win;
+static Pixmap bar_pixmap;
+static GC bar_gc;
+static XFontSet fontset;
+static int bar_w, bar_h, ascent;
+static Segment *segs;
+static int num_segs;
+static ModuleState *mods;
+static int inotify_fd = -1;
+
+static int text_width(const char *text) {
+    XRectangle ink, logical;
+
+    Xutf8TextExtents(fontset, text, strlen(text), &ink, &logical);
+    return logical.width;
+}
+
+static void set_text(int i, const char *text) {
+    if (strcmp(segs[i].text, text) != 0) {
+        snprintf(segs[i].text, sizeof(segs[i].text), "%s", text);
+        segs[i].dirty = true;
+    }
+}
+
+static void module_work(void *arg) {
+    ModuleState *m = arg;
+
+    m->buf[0] = '\0';
+    config.modules[m->index].func(config.modules[m->index].arg, m->buf, sizeof(m->buf));
+}
+
+static void run_module(int i);
+
+static void module_done(void *arg) {
+    ModuleState *m = arg;
+
+    m->busy = false;
+    if (job_cancelled()) {
+        m->again = false;
+        return;
+    }
+    set_text(SegModules + m->index, m->buf);
+    if (m->again) {
+        m->again = false;
+        run_module(m->index);
+    }
+}
+
+/* Modules read /proc and files, so they run on the worker pool; a refresh
+ * requested while one is running is done once it finishes */
+static void run_module(int i) {
+    if (mods[i].busy) {
+        mods[i].again = true;
+        return;
+    }
+    mods[i].busy = true;
+    queue_job(module_work, module_done, &mods[i]);
+}
+
+static void place(int i, int x, int w) {
+    if (segs[i].x != x || segs[i].w != w) {
+        segs[i].x = x;
+        segs[i].w = w;
+        segs[i].dirty = true;
+    }
+}
+
+/* Work out where every segment goes; moved segments become dirty too */
+static void arrange(void) {
+    int x = bar_w;
+
+    for (int i = num_segs - 1; i >= SegModules; i--) {
+        int w = segs[i].text[0] ? text_width(segs[i].text) + 2 * BAR_PAD : 0;
+        x -= w;
+        place(i, x, w);
+    }
+    int lw = text_width(segs[SegLayout].text) + 2 * BAR_PAD;
+    place(SegLayout, 0, lw);
+    place(SegTitle, lw, x > lw ? x - lw : 0);
+}
+
+static void draw_segment(Segment *s, bool highlight) {
+    XRectangle clip = { s->x, 0, s->w, bar_h };
+
+    XSetForeground(dpy, bar_gc, highlight ? config.bar_fg : config.bar_bg);
+    XFillRectangle(dpy, bar_pixmap, bar_gc, s->x, 0, s->w, bar_h);
+    if (!s->text[0] || !s->w) {
+        return;
+    }
+    XSetClipRectangles(dpy, bar_gc, 0, 0, &clip, 1, Unsorted);
+    XSetForeground(dpy, bar_gc, highlight ? config.bar_bg : config.bar_fg);
+    Xutf8DrawString(dpy, bar_pixmap, fontset, bar_gc, s->x + BAR_PAD,
+                    (bar_h + ascent) / 2 - 1, s->text, strlen(s->text));
+    XSetClipMask(dpy, bar_gc, None);
+}
+
+void update_bar(void) {
+    int x0 = bar_w, x1 = 0;
+
+    if (!bar_win) {
+        return;
+    }
+
+    set_text(SegLayout, mon->layout ? mon->layout->name : "");
+    set_text(SegTitle, mon->selected ? mon->selected->name : "");
+    arrange();
+
+    for (int i = 0; i < num_segs; i++) {
+        if (!segs[i].dirty) {
+            continue;
+        }
+        segs[i].dirty = false;
+        draw_segment(&segs[i], i == SegLayout);
+        stats.bar_redraws++;
+        if (segs[i].x < x0) {
+            x0 = segs[i].x;
+        }
+        if (segs[i].x + segs[i].w > x1) {
+            x1 = segs[i].x + segs[i].w;
+        }
+    }
+    if (x1 > x0) {
+        XCopyArea(dpy, bar_pixmap, bar_win, bar_gc, x0, 0, x1 - x0, bar_h, x0, 0);
+    }
+}
+
+Window bar_window(void) {
+    return bar_win;
+}
+
+void expose_bar(Window w) {
+    if (bar_win && w == bar_win) {
+        XCopyArea(dpy, bar_pixmap, bar_win, bar_gc, 0, 0, bar_w, bar_h, 0, 0);
+    }
+}
+
+static void on_timer(int fd, short revents) {
+    uint64_t expirations;
+
+    (void)revents;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    for (int i = 0; i < config.num_modules; i++) {
+        if (mods[i].timer_fd == fd) {
+            run_module(i);
+        }
+    }
+}
+
+static void on_inotify(int fd, short revents) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    (void)revents;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            for (int i = 0; i < config.num_modules; i++) {
+                if (mods[i].watch_wd == ev->wd && ev->len &&
+                    !strcmp(ev->name, mods[i].watch_name)) {
+                    run_module(i);
+                }
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+/* First expiry on a multiple of the interval, so a per-minute clock
+ * ticks exactly when the minute changes */
+static int start_timer(int interval) {
+    struct itimerspec its;
+    struct timespec now;
+    int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+    clock_gettime(CLOCK_REALTIME, &now);
+    its.it_interval.tv_sec = interval;
+    its.it_interval.tv_nsec = 0;
+    its.it_value.tv_sec = (now.tv_sec / interval + 1) * interval;
+    its.it_value.tv_nsec = 0;
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+    watch_fd(fd, POLLIN, on_timer);
+    return fd;
+}
+
+static void start_watch(ModuleState *m, const char *path) {
+    const char *home = getenv("HOME");
+    char *slash;
+
+    if (path[0] == '~' && home) {
+        snprintf(m->watch_path, sizeof(m->watch_path), "%s%s", home, path + 1);
+    } else {
+        snprintf(m->watch_path, sizeof(m->watch_path), "%s", path);
+    }
+    if (!(slash = strrchr(m->watch_path, '/'))) {
+        return;
+    }
+    if (inotify_fd < 0) {
+        if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+            return;
+        }
+        watch_fd(inotify_fd, POLLIN, on_inotify);
+    }
+
+    /* Watch the directory: editors and scripts usually replace the file */
+    *slash = '\0';
+    m->watch_wd = inotify_add_watch(inotify_fd, m->watch_path,
+                                    IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+    *slash = '/';
+    m->watch_name = slash + 1;
+}
+
+void create_bar(void) {
+    XSetWindowAttributes wa;
+    XFontSetExtents *extents;
+    char **missing, *def;
+    int nmissing;
+
+    if (!config.show_bar || !dpy) {
+        return;
+    }
+
+    if (!(fontset = XCreateFontSet(dpy, config.font, &missing, &nmissing, &def))) {
+        fprintf(stderr, "swm: cannot load font '%s', using 'fixed'\n", config.font);
+        if (!(fontset = XCreateFontSet(dpy, "fixed", &missing, &nmissing, &def))) {
+            fprintf(stderr, "swm: no usable font, bar disabled\n");
+            return;
+        }
+    }
+    if (missing) {
+        XFreeStringList(missing);
+    }
+    extents = XExtentsOfFontSet(fontset);
+    ascent = -extents->max_logical_extent.y;
+
+    bar_w = screen_width - (tray ? tray->w : 0);
+    bar_h = screen_height - (mon->y + mon->h);
+    if (bar_w <= 0 || bar_h <= 0) {
+        return;
+    }
+
+    wa.override_redirect = True;
+    wa.background_pixel = config.bar_bg;
+    wa.event_mask = ExposureMask;
+    bar_win = XCreateWindow(dpy, root, 0, mon->y + mon->h, bar_w, bar_h, 0,
+                            DefaultDepth(dpy, screen), CopyFromParent,
+                            DefaultVisual(dpy, screen),
+                            CWOverrideRedirect | CWBackPixel | CWEventMask, &wa);
+    bar_pixmap = XCreatePixmap(dpy, root, bar_w, bar_h, DefaultDepth(dpy, screen));
+    bar_gc = XCreateGC(dpy, root, 0, NULL);
+    XSetForeground(dpy, bar_gc, config.bar_bg);
+    XFillRectangle(dpy, bar_pixmap, bar_gc, 0, 0, bar_w, bar_h);
+
+    num_segs = SegModules + config.num_modules;
+    segs = calloc(num_segs, sizeof(Segment));
+    mods = calloc(config.num_modules ? config.num_modules : 1, sizeof(ModuleState));
+    for (int i = 0; i < config.num_modules; i++) {
+        mods[i].index = i;
+        mods[i].timer_fd = -1;
+        mods[i].watch_wd = -1;
+        if (config.modules[i].interval > 0) {
+            mods[i].timer_fd = start_timer(config.modules[i].interval);
+        }
+        if (config.modules[i].watch) {
+            start_watch(&mods[i], config.modules[i].watch);
+        }
+        run_module(i);
+    }
+
+    XMapWindow(dpy, bar_win);
+    stack_changed();
+    update_bar();
+}
+
+void destroy_bar(void) {
+    if (!bar_win) {
+        return;
+    }
+    for (int i = 0; i < config.num_modules; i++) {
+        if (mods[i].timer_fd >= 0) {
+            unwatch_fd(mods[i].timer_fd);
+            close(mods[i].timer_fd);
+        }
+    }
+    if (inotify_fd >= 0) {
+        unwatch_fd(inotify_fd);
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    free(mods);
+    free(segs);
+    XFreeGC(dpy, bar_gc);
+    XFreePixmap(dpy, bar_pixmap);
+    XDestroyWindow(dpy, bar_win);
+    XFreeFontSet(dpy, fontset);
+    bar_win = None;
+}
+
+/* Status modules */
+
+void status_clock(const char *arg, char *buf, size_t size) {
+    time_t t = time(NULL);
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    strftime(buf, size, arg ? arg : "%H:%M", &tm);
+}
+
+void status_load(const char *arg, char *buf, size_t size) {
+    FILE *fp = fopen("/proc/loadavg", "r");
+    double load;
+
+    (void)arg;
+    if (fp) {
+        if (fscanf(fp, "%lf", &load) == 1) {
+            snprintf(buf, size, "load %.2f", load);
+        }
+        fclose(fp);
+    }
+}
+
+void status_mem(const char *arg, char *buf, size_t size) {
+    FILE *fp = fopen("/proc/meminfo", "r");
+    char line[128];
+    unsigned long total = 0, avail = 0;
+
+    (void)arg;
+    if (!fp) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        sscanf(line, "MemTotal: %lu kB", &total);
+        sscanf(line, "MemAvailable: %lu kB", &avail);
+    }
+    fclose(fp);
+    if (total) {
+        snprintf(buf, size, "mem %lu%%", (total - avail) * 100 / total);
+    }
+}
+
+/* First line of a file, e.g. one written by a script when something changes */
+void status_file(const char *arg, char *buf, size_t size) {
+    const char *home = getenv("HOME");
+    char path[BAR_TEXT_MAX];
+    FILE *fp;
+
+    if (!arg) {
+        return;
+    }
+    if (arg[0] == '~' && home) {
+        snprintf(path, sizeof(path), "%s%s", home, arg + 1);
+    } else {
+        snprintf(path, sizeof(path), "%s", arg);
+    }
+    if ((fp = fopen(path, "r"))) {
+        if (fgets(buf, size, fp)) {
+            buf[strcspn(buf, "\n")] = '\0';
+        }
+        fclose(fp);
+    }
+}
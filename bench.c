@@ -0,0 +1,253 @@
+/*
+ * Layout Benchmark
+ *
+ * Runs every tiling layout from config.h on the mock backend over
+ * synthetic monitors and prints one JSON record per configuration:
+ * time per pass and per client, allocations and X requests per pass, and
+ * whether the output geometry holds the layout invariants.  A pass of
+ * the split tree layouts over an unchanged tree does nothing, so they are
+ * timed per operation instead: a full relayout, a window leaving and
+ * rejoining the tree, and a split resize.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swm.h"
+#include "config.h"
+
+/* Roughly this many client placements are timed per configuration */
+#define BENCH_WORK      2000000L
+/* Pairwise overlap checks are quadratic; above this only bounds are checked */
+#define BENCH_OVERLAP_MAX 2000
+
+static const int client_counts[] = { 1, 10, 100, 1000, 10000 };
+static const struct { float master_factor; int num_master; } params[] = {
+    { 0.55, 1 },
+    { 0.30, 3 },
+    { 0.75, 0 },
+};
+static const int floating_pct[] = { 0, 25 };
+
+enum { OpFull, OpInsertRemove, OpResize, OpLast };
+static const char *op_names[OpLast] = { "full", "insert_remove", "resize" };
+
+/* Allocation counters, fed by the linker's --wrap of the allocator */
+static unsigned long allocs;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    allocs++;
+    return __real_realloc(p, size);
+}
+
+typedef struct {
+    unsigned long negative;
+    unsigned long out_of_bounds;
+    unsigned long overlaps;
+    double coverage;
+    bool overlap_checked;
+} Invariants;
+
+static bool is_visible(Client *c) {
+    XWindowAttributes wa;
+
+    return be->get_attributes(c->win, &wa) && wa.map_state == IsViewable;
+}
+
+static void check(Monitor *m, Invariants *inv) {
+    int n = 0;
+    double area = 0;
+    Client *c, **tiled;
+
+    memset(inv, 0, sizeof(*inv));
+    for (c = m->clients; c; c = c->next) {
+        n++;
+    }
+    tiled = malloc(n * sizeof(Client *));
+    n = 0;
+    for (c = m->clients; c; c = c->next) {
+        if (c->is_floating || c->is_fullscreen || !is_visible(c)) {
+            continue;
+        }
+        if (c->w <= 0 || c->h <= 0) {
+            inv->negative++;
+            continue;
+        }
+        int bw = c->bw;
+        if (c->x < m->x || c->y < m->y ||
+            c->x + c->w + 2 * bw > m->x + m->w ||
+            c->y + c->h + 2 * bw > m->y + m->h) {
+            inv->out_of_bounds++;
+        }
+        area += (double)(c->w + 2 * bw) * (c->h + 2 * bw);
+        tiled[n++] = c;
+    }
+    inv->coverage = area / ((double)m->w * m->h);
+
+    if (n <= BENCH_OVERLAP_MAX) {
+        inv->overlap_checked = true;
+        for (int i = 0; i < n; i++) {
+            Client *a = tiled[i];
+            for (int j = i + 1; j < n; j++) {
+                Client *b = tiled[j];
+                if (a->x < b->x + b->w + 2 * b->bw && b->x < a->x + a->w + 2 * a->bw &&
+                    a->y < b->y + b->h + 2 * b->bw && b->y < a->y + a->h + 2 * a->bw) {
+                    inv->overlaps++;
+                }
+            }
+        }
+    }
+    free(tiled);
+}
+
+static void populate(Monitor *m, int n, int pct) {
+    for (int i = 0; i < n; i++) {
+        Client *c = create_client(mock_add_window(10 * (i % 50), 10 * (i % 40),
+                                                  400, 300, false));
+        c->is_floating = pct && i % (100 / pct) == 0;
+        attach_client(c);
+    }
+    for (Client *c = m->clients; c; c = c->next) {
+        if (!c->is_floating) {
+            m->selected = c;
+            break;
+        }
+    }
+}
+
+/* The change a timed pass of a tree layout lays out */
+static void prepare(Monitor *m, int op, Client *toggled, long i) {
+    switch (op) {
+    case OpFull:
+        m->tree_stale = true;
+        break;
+    case OpInsertRemove:
+        if (toggled) {
+            toggled->is_floating = !toggled->is_floating;
+        }
+        break;
+    case OpResize:
+        tree_resize(m->selected, i % 2 ? 0.05 : -0.05);
+        break;
+    }
+}
+
+/* The newest tiled window, so leaving and rejoining keeps the tree's shape */
+static Client *newest_tiled(Monitor *m) {
+    Client *last = NULL;
+
+    for (Client *c = m->clients; c; c = c->next) {
+        if (!c->is_floating) {
+            last = c;
+        }
+    }
+    return last;
+}
+
+static void clear(Monitor *m) {
+    while (m->clients) {
+        Client *c = m->clients;
+        detach_client(c);
+        free(c);
+    }
+    m->selected = NULL;
+}
+
+int main(void) {
+    Monitor m;
+    bool first = true;
+
+    /* config.h comes whole; only its layouts are benchmarked */
+    (void)keys;
+    be = &mock_backend;
+    be->open();
+    config.border_width = BORDER_WIDTH;
+    config.border_normal = 0;
+    config.border_focus = 0;
+
+    memset(&m, 0, sizeof(m));
+    m.w = screen_width;
+    m.h = screen_height - TRAY_HEIGHT;
+    mon = &m;
+
+    printf("[\n");
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        if (layouts[l].apply == floating_layout) {
+            continue;
+        }
+        m.layout = &layouts[l];
+        for (size_t k = 0; k < sizeof(client_counts) / sizeof(client_counts[0]); k++) {
+            int n = client_counts[k];
+            for (size_t p = 0; p < sizeof(params) / sizeof(params[0]); p++) {
+                for (size_t f = 0; f < sizeof(floating_pct) / sizeof(floating_pct[0]); f++) {
+                    bool tree = is_tree_layout(m.layout);
+                    for (int op = OpFull; op < (tree ? OpLast : OpFull + 1); op++) {
+                        Invariants inv;
+                        long passes = BENCH_WORK / n > 0 ? BENCH_WORK / n : 1;
+
+                        m.master_factor = params[p].master_factor;
+                        m.num_master = params[p].num_master;
+                        populate(&m, n, floating_pct[f]);
+                        m.layout->apply(&m);
+                        Client *toggled = newest_tiled(&m);
+
+                        unsigned long a0 = allocs, r0 = be->requests();
+                        long long t0 = now_ns();
+                        for (long i = 0; i < passes; i++) {
+                            if (tree) {
+                                prepare(&m, op, toggled, i);
+                            }
+                            m.layout->apply(&m);
+                        }
+                        long long elapsed = now_ns() - t0;
+                        unsigned long a = allocs - a0, r = be->requests() - r0;
+
+                        /* An odd number of toggles leaves the window out */
+                        if (op == OpInsertRemove && toggled && toggled->is_floating) {
+                            toggled->is_floating = false;
+                            m.layout->apply(&m);
+                        }
+                        check(&m, &inv);
+                        printf("%s  {\"layout\": \"%s\", \"operation\": \"%s\", \"clients\": %d, "
+                               "\"master_factor\": %.2f, \"num_master\": %d, "
+                               "\"floating_pct\": %d, \"passes\": %ld, "
+                               "\"ns_per_pass\": %.1f, \"ns_per_client\": %.2f, "
+                               "\"allocs_per_pass\": %.2f, \"requests_per_pass\": %.1f, "
+                               "\"invariants\": {\"negative_sizes\": %lu, "
+                               "\"out_of_bounds\": %lu, \"overlaps\": %ld, "
+                               "\"coverage\": %.4f}}",
+                               first ? "" : ",\n", m.layout->name, op_names[op], n,
+                               m.master_factor, m.num_master, floating_pct[f],
+                               passes, (double)elapsed / passes,
+                               (double)elapsed / passes / n,
+                               (double)a / passes, (double)r / passes,
+                               inv.negative, inv.out_of_bounds,
+                               inv.overlap_checked ? (long)inv.overlaps : -1L,
+                               inv.coverage);
+                        first = false;
+                        clear(&m);
+                    }
+                }
+            }
+        }
+    }
+    printf("\n]\n");
+
+    be->close();
+    return EXIT_SUCCESS;
+}
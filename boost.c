@@ -0,0 +1,228 @@
+/*
+ * Focus CPU Boost
+ *
+ * Gives the focused window's process more CPU than background work.
+ * When the process runs in a cgroup of its own (a systemd scope, say),
+ * that cgroup's cpu.weight is raised; otherwise its process group gets
+ * a lower nice value.  Whatever was boosted goes back to the value read
+ * before the boost once focus moves on.  Writes happen at most once per
+ * BOOST_INTERVAL_MS; focus changes in between only update what the next
+ * write will boost, so flipping through windows costs one write.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include "swm.h"
+
+#define BOOST_INTERVAL_MS   250
+#define CGROUP_ROOT         "/sys/fs/cgroup"
+
+typedef struct {
+    pid_t pid;                  /* 0 when nothing is boosted */
+    pid_t pgid;                 /* niced instead, when cgroup is empty */
+    char cgroup[600];
+    char old_weight[32];
+    int old_nice;
+} Boost;
+
+static Boost boosted;
+static pid_t wanted;
+static long long last_ns;
+static int timer_fd = -1;
+static bool timer_armed;
+static char own_cgroup[512];
+
+/* The cgroup v2 path of a process, from the "0::" line */
+static bool read_cgroup(const char *proc, char *path, size_t size) {
+    char file[64], line[512];
+    bool found = false;
+    FILE *fp;
+
+    snprintf(file, sizeof(file), "/proc/%s/cgroup", proc);
+    if (!(fp = fopen(file, "r"))) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (!strncmp(line, "0::", 3)) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(path, size, "%s", line + 3);
+            found = true;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+bool cgroup_read(const char *dir, const char *file, char *buf, size_t size) {
+    char path[700];
+    FILE *fp;
+    bool ok;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if (!(fp = fopen(path, "r"))) {
+        return false;
+    }
+    ok = fgets(buf, size, fp) != NULL;
+    fclose(fp);
+    buf[strcspn(buf, "\n")] = '\0';
+    return ok;
+}
+
+bool cgroup_write(const char *dir, const char *file, const char *value) {
+    char path[700];
+    FILE *fp;
+    bool ok;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if (!(fp = fopen(path, "w"))) {
+        return false;
+    }
+    ok = fputs(value, fp) >= 0;
+    return fclose(fp) == 0 && ok;
+}
+
+/* The directory of the process's own cgroup.  A cgroup shared with swm
+ * holds the whole session; acting on it would hit everything, so only a
+ * cgroup of the client's own counts. */
+bool cgroup_dir(pid_t pid, char *dir, size_t size) {
+    char proc[16], cgroup[512];
+
+    snprintf(proc, sizeof(proc), "%d", (int)pid);
+    if (!own_cgroup[0] && !read_cgroup("self", own_cgroup, sizeof(own_cgroup))) {
+        return false;
+    }
+    if (!read_cgroup(proc, cgroup, sizeof(cgroup)) ||
+        !strcmp(cgroup, "/") || !strcmp(cgroup, own_cgroup)) {
+        return false;
+    }
+    snprintf(dir, size, CGROUP_ROOT "%s", cgroup);
+    return true;
+}
+
+static bool boost_cgroup(pid_t pid) {
+    char value[32];
+
+    snprintf(value, sizeof(value), "%d", config.boost_weight);
+    if (!cgroup_dir(pid, boosted.cgroup, sizeof(boosted.cgroup)) ||
+        !cgroup_read(boosted.cgroup, "cpu.weight", boosted.old_weight,
+                     sizeof(boosted.old_weight)) ||
+        atoi(boosted.old_weight) >= config.boost_weight ||
+        !cgroup_write(boosted.cgroup, "cpu.weight", value)) {
+        boosted.cgroup[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+static bool boost_nice(pid_t pid) {
+    pid_t pgid = getpgid(pid);
+
+    /* Never swm's own group */
+    if (pgid <= 0 || pgid == getpgrp()) {
+        return false;
+    }
+    errno = 0;
+    boosted.old_nice = getpriority(PRIO_PGRP, pgid);
+    if (errno || boosted.old_nice <= config.boost_nice ||
+        setpriority(PRIO_PGRP, pgid, config.boost_nice) < 0) {
+        return false;
+    }
+    boosted.pgid = pgid;
+    return true;
+}
+
+static void restore(void) {
+    if (!boosted.pid) {
+        return;
+    }
+    /* The process may be gone by now; nothing to restore then */
+    if (boosted.cgroup[0]) {
+        cgroup_write(boosted.cgroup, "cpu.weight", boosted.old_weight);
+    } else if (boosted.pgid) {
+        setpriority(PRIO_PGRP, boosted.pgid, boosted.old_nice);
+    }
+    memset(&boosted, 0, sizeof(boosted));
+}
+
+static void apply(void) {
+    last_ns = now_ns();
+    if (wanted == boosted.pid) {
+        return;
+    }
+    restore();
+    if (wanted <= 0) {
+        return;
+    }
+    trace_begin("boost", "boost");
+    boosted.pid = wanted;
+    if (boost_cgroup(wanted) || boost_nice(wanted)) {
+        stats.boosts++;
+    } else {
+        stats.boost_failures++;
+    }
+    trace_end();
+}
+
+static void on_timer(int fd, short revents) {
+    uint64_t expirations;
+
+    (void)revents;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    timer_armed = false;
+    apply();
+}
+
+/* Called on every focus change; only remembers the target when the
+ * last write was too recent */
+void boost_focus(Client *c) {
+    long long wait_ns;
+
+    if (!config.focus_boost) {
+        return;
+    }
+    wanted = c ? c->pid : 0;
+    if (wanted == boosted.pid && !timer_armed) {
+        return;
+    }
+    wait_ns = last_ns + BOOST_INTERVAL_MS * 1000000LL - now_ns();
+    if (wait_ns <= 0) {
+        apply();
+        return;
+    }
+    stats.boosts_deferred++;
+    if (timer_armed) {
+        return;
+    }
+    if (timer_fd < 0) {
+        if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+            return;
+        }
+        watch_fd(timer_fd, POLLIN, on_timer);
+    }
+    struct itimerspec its = { { 0, 0 }, { wait_ns / 1000000000, wait_ns % 1000000000 } };
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    timer_armed = true;
+}
+
+void end_boost(void) {
+    restore();
+    if (timer_fd >= 0) {
+        unwatch_fd(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+        timer_armed = false;
+    }
+}
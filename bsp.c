@@ -0,0 +1,265 @@
+/*
+ * Split Tree Layouts
+ *
+ * bsp, spiral and dwindle keep a binary split tree on the monitor that
+ * persists between layout passes.  Inserting or removing a client and
+ * resizing a split only mark the affected subtree dirty, and a pass
+ * descends only into dirty subtrees, so a change costs geometry work and
+ * X requests proportional to what actually moved instead of every window.
+ */
+
+#include <stdlib.h>
+#include "swm.h"
+
+#define SPLIT_RATIO     0.5
+
+enum { InsertBsp, InsertSpiral, InsertDwindle };
+
+struct SplitNode {
+    SplitNode *parent;
+    SplitNode *first, *second;  /* both NULL for a leaf */
+    Client *client;             /* leaves only */
+    bool vertical;              /* children side by side rather than stacked */
+    float ratio;                /* share of the first child */
+    bool dirty;                 /* own area changed, lay out the whole subtree */
+    bool dirty_below;           /* some descendant is dirty */
+    int x, y, w, h;
+};
+
+static bool is_tiled(Client *c) {
+    return !c->is_floating && !c->is_fullscreen && !c->is_iconic;
+}
+
+static void mark_dirty(SplitNode *n) {
+    n->dirty = true;
+    for (SplitNode *p = n->parent; p && !p->dirty_below; p = p->parent) {
+        p->dirty_below = true;
+    }
+}
+
+static int depth(SplitNode *n) {
+    int d = 0;
+
+    for (; n->parent; n = n->parent) {
+        d++;
+    }
+    return d;
+}
+
+/* Put n where old was in the tree */
+static void replace(Monitor *m, SplitNode *old, SplitNode *n) {
+    n->parent = old->parent;
+    if (!old->parent) {
+        m->tree = n;
+    } else if (old->parent->first == old) {
+        old->parent->first = n;
+    } else {
+        old->parent->second = n;
+    }
+}
+
+static SplitNode *last_leaf(SplitNode *n) {
+    while (n->second) {
+        n = n->second;
+    }
+    return n;
+}
+
+/* Hand out a split's area to its two children */
+static void divide(SplitNode *n) {
+    SplitNode *a = n->first, *b = n->second;
+
+    a->x = b->x = n->x;
+    a->y = b->y = n->y;
+    if (n->vertical) {
+        a->w = n->w * n->ratio;
+        a->h = b->h = n->h;
+        b->x = n->x + a->w;
+        b->w = n->w - a->w;
+    } else {
+        a->w = b->w = n->w;
+        a->h = n->h * n->ratio;
+        b->y = n->y + a->h;
+        b->h = n->h - a->h;
+    }
+}
+
+static void insert(Monitor *m, Client *c, int policy) {
+    SplitNode *leaf = calloc(1, sizeof(SplitNode));
+    SplitNode *target, *split;
+
+    leaf->client = c;
+    c->leaf = leaf;
+    if (!m->tree) {
+        m->tree = leaf;
+        m->tree_last = leaf;
+        leaf->x = m->x;
+        leaf->y = m->y;
+        leaf->w = m->w;
+        leaf->h = m->h;
+        mark_dirty(leaf);
+        return;
+    }
+
+    /* bsp splits the focused window, spiral and dwindle the newest one */
+    target = policy == InsertBsp && m->split_at ? m->split_at : m->tree_last;
+    if (!target) {
+        target = last_leaf(m->tree);
+    }
+
+    split = calloc(1, sizeof(SplitNode));
+    split->ratio = SPLIT_RATIO;
+    split->x = target->x;
+    split->y = target->y;
+    split->w = target->w;
+    split->h = target->h;
+    replace(m, target, split);
+    target->parent = split;
+    leaf->parent = split;
+
+    int d = depth(split);
+    if (policy == InsertBsp) {
+        split->vertical = target->w >= target->h;
+    } else {
+        split->vertical = d % 2 == 0;
+    }
+    /* Spiral turns inwards: right, down, left, up, right, ... */
+    if (policy == InsertSpiral && d % 4 >= 2) {
+        split->first = leaf;
+        split->second = target;
+    } else {
+        split->first = target;
+        split->second = leaf;
+    }
+
+    /* Areas are needed right away: the next insert may split this leaf */
+    divide(split);
+    m->tree_last = leaf;
+    mark_dirty(split);
+}
+
+void tree_remove(Client *c) {
+    SplitNode *leaf = c->leaf, *split, *sibling;
+
+    if (!leaf) {
+        return;
+    }
+    c->leaf = NULL;
+    if (mon->split_at == leaf) {
+        mon->split_at = NULL;
+    }
+
+    if (!(split = leaf->parent)) {
+        mon->tree = NULL;
+        mon->tree_last = NULL;
+        free(leaf);
+        return;
+    }
+
+    /* The sibling takes over the parent's area */
+    sibling = split->first == leaf ? split->second : split->first;
+    replace(mon, split, sibling);
+    sibling->x = split->x;
+    sibling->y = split->y;
+    sibling->w = split->w;
+    sibling->h = split->h;
+    mark_dirty(sibling);
+    if (mon->tree_last == leaf) {
+        mon->tree_last = last_leaf(sibling);
+    }
+    free(split);
+    free(leaf);
+}
+
+/* Remember where bsp puts the next window */
+void tree_focus(Client *c) {
+    if (c->leaf) {
+        mon->split_at = c->leaf;
+    }
+}
+
+static void place(SplitNode *n) {
+    n->dirty = false;
+    n->dirty_below = false;
+    if (n->client) {
+        Client *c = n->client;
+        resize_client(c, n->x, n->y, n->w - 2 * c->bw, n->h - 2 * c->bw);
+        show_client(c);
+        return;
+    }
+
+    divide(n);
+    place(n->first);
+    place(n->second);
+}
+
+/* Lay out only what changed since the last pass */
+static void relayout(SplitNode *n) {
+    if (n->dirty) {
+        place(n);
+    } else if (n->dirty_below) {
+        n->dirty_below = false;
+        relayout(n->first);
+        relayout(n->second);
+    }
+}
+
+static void tree_layout(Monitor *m, int policy) {
+    /* Pick up windows that became tiled or stopped being tiled.  This
+     * is a flag check per client; geometry is only touched below. */
+    for (Client *c = m->clients; c; c = c->next) {
+        if (c->leaf && !is_tiled(c)) {
+            tree_remove(c);
+        } else if (!c->leaf && is_tiled(c)) {
+            insert(m, c, policy);
+        }
+    }
+    if (!m->tree) {
+        return;
+    }
+
+    /* Another layout moved the windows around; place everything again */
+    if (m->tree_stale) {
+        m->tree_stale = false;
+        m->tree->x = m->x;
+        m->tree->y = m->y;
+        m->tree->w = m->w;
+        m->tree->h = m->h;
+        mark_dirty(m->tree);
+    }
+    relayout(m->tree);
+}
+
+void bsp_layout(Monitor *m) {
+    tree_layout(m, InsertBsp);
+}
+
+void spiral_layout(Monitor *m) {
+    tree_layout(m, InsertSpiral);
+}
+
+void dwindle_layout(Monitor *m) {
+    tree_layout(m, InsertDwindle);
+}
+
+bool is_tree_layout(const TilingLayout *l) {
+    return l && (l->apply == bsp_layout || l->apply == spiral_layout ||
+                 l->apply == dwindle_layout);
+}
+
+/* Grow (delta > 0) or shrink the client's side of its enclosing split */
+bool tree_resize(Client *c, float delta) {
+    SplitNode *split;
+    float ratio;
+
+    if (!c || !c->leaf || !(split = c->leaf->parent)) {
+        return false;
+    }
+    ratio = split->ratio + (split->first == c->leaf ? delta : -delta);
+    if (ratio < 0.1 || ratio > 0.9) {
+        return false;
+    }
+    split->ratio = ratio;
+    mark_dirty(split);
+    return true;
+}
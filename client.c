@@ -2,16 +2,209 @@
  * Client (Window) Management
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
 #include "swm.h"
 
+/* _NET_WM_STATE atoms kept when swm rewrites the property */
+#define STATE_MAX       32
+
+/* True for dialogs, utility windows and splash screens */
+static bool update_window_type(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    bool dialog = false;
+    
+    if (be->get_property(c->win, netatom[NetWMWindowType], XA_ATOM, 8,
+                         &actual_type, &actual_format, &nitems, &data) != Success || !data) {
+        return false;
+    }
+    for (unsigned long i = 0; i < nitems; i++) {
+        Atom type = ((Atom *)data)[i];
+        if (type == netatom[NetWMWindowTypeDesktop]) {
+            /* Keeps its own geometry, below everything else */
+            c->is_desktop = true;
+            c->is_floating = true;
+            c->bw = 0;
+        }
+        dialog |= type == netatom[NetWMWindowTypeDialog] ||
+                  type == netatom[NetWMWindowTypeUtility] ||
+                  type == netatom[NetWMWindowTypeSplash];
+    }
+    XFree(data);
+    return dialog;
+}
+
+static void update_transient(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    
+    c->transient_for = None;
+    if (be->get_property(c->win, XA_WM_TRANSIENT_FOR, XA_WINDOW, 1,
+                         &actual_type, &actual_format, &nitems, &data) == Success && data) {
+        if (actual_format == 32 && nitems == 1 && *(Window *)data != c->win) {
+            c->transient_for = *(Window *)data;
+        }
+        XFree(data);
+    }
+}
+
+/* WM_NORMAL_HINTS with the same minimum and maximum size: tiling could
+ * only leave the window in a corner of its cell.  Also says whether the
+ * user asked for a position. */
+static bool is_fixed_size(Client *c, bool *positioned) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    bool fixed = false;
+    
+    *positioned = false;
+    if (be->get_property(c->win, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18,
+                         &actual_type, &actual_format, &nitems, &data) != Success || !data) {
+        return false;
+    }
+    if (actual_format == 32 && nitems >= 9) {
+        /* flags, x, y, width, height, min_width, min_height, max_width, max_height */
+        long *hints = (long *)data;
+        *positioned = hints[0] & USPosition;
+        fixed = (hints[0] & PMinSize) && (hints[0] & PMaxSize) && hints[5] > 0 &&
+                hints[5] == hints[7] && hints[6] == hints[8];
+    }
+    XFree(data);
+    return fixed;
+}
+
+/* States a client may set before mapping; _NET_WM_STATE_HIDDEN is the
+ * window manager's to set */
+static void update_window_state(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    
+    if (be->get_property(c->win, netatom[NetWMState], XA_ATOM, NetLast,
+                         &actual_type, &actual_format, &nitems, &data) != Success || !data) {
+        return;
+    }
+    for (unsigned long i = 0; i < nitems; i++) {
+        Atom state = ((Atom *)data)[i];
+        c->is_fullscreen |= state == netatom[NetWMStateFullscreen];
+        c->is_above |= state == netatom[NetWMStateAbove];
+    }
+    XFree(data);
+}
+
+static void update_protocols(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    
+    if (be->get_property(c->win, wmatom[WMProtocols], XA_ATOM, 32,
+                         &actual_type, &actual_format, &nitems, &data) != Success || !data) {
+        return;
+    }
+    for (unsigned long i = 0; i < nitems; i++) {
+        Atom protocol = ((Atom *)data)[i];
+        c->can_delete |= protocol == wmatom[WMDelete];
+        c->can_ping |= protocol == netatom[NetWMPing];
+    }
+    XFree(data);
+}
+
+static bool get_text_property(Window w, Atom prop, Atom type, char *text, size_t size);
+
+/* _NET_WM_PID means nothing for a client on another host */
+static void update_pid(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    char host[256], local[256];
+    
+    c->pid = 0;
+    if (be->get_property(c->win, netatom[NetWMPid], XA_CARDINAL, 1,
+                         &actual_type, &actual_format, &nitems, &data) == Success && data) {
+        if (actual_format == 32 && nitems == 1) {
+            c->pid = *(long *)data;
+        }
+        XFree(data);
+    }
+    if (!c->pid) {
+        c->pid = be->client_pid(c->win);
+    } else if (get_text_property(c->win, XA_WM_CLIENT_MACHINE, XA_STRING, host, sizeof(host)) &&
+               (gethostname(local, sizeof(local)) != 0 || strcmp(host, local) != 0)) {
+        c->pid = 0;
+    }
+}
+
+/* Centered over the parent if it is on screen, else over the monitor,
+ * and kept inside the monitor */
+static void place_dialog(Client *c) {
+    Client *p = c->transient_for ? find_client(c->transient_for) : NULL;
+    int w = c->w + 2 * c->bw, h = c->h + 2 * c->bw;
+    int x, y;
+    
+    if (p && !p->is_hidden) {
+        x = p->x + (p->w + 2 * p->bw - w) / 2;
+        y = p->y + (p->h + 2 * p->bw - h) / 2;
+    } else {
+        x = mon->x + (mon->w - w) / 2;
+        y = mon->y + (mon->h - h) / 2;
+    }
+    if (x + w > mon->x + mon->w) {
+        x = mon->x + mon->w - w;
+    }
+    if (y + h > mon->y + mon->h) {
+        y = mon->y + mon->h - h;
+    }
+    if (x < mon->x) {
+        x = mon->x;
+    }
+    if (y < mon->y) {
+        y = mon->y;
+    }
+    resize_client(c, x, y, c->w, c->h);
+}
+
+/* Everything create_client() reads, requested at once so a map costs one
+ * round trip instead of one per property */
+static void prefetch_properties(Client *c) {
+    PropertyRequest req[] = {
+        { netatom[NetWMName], netatom[NetUTF8String], sizeof(c->name) / 4 },
+        { XA_WM_NAME, AnyPropertyType, sizeof(c->name) / 4 },
+        { netatom[NetWMWindowType], XA_ATOM, 8 },
+        { netatom[NetWMState], XA_ATOM, NetLast },
+        { wmatom[WMProtocols], XA_ATOM, 32 },
+        { XA_WM_TRANSIENT_FOR, XA_WINDOW, 1 },
+        { XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18 },
+        { netatom[NetWMPid], XA_CARDINAL, 1 },
+        { XA_WM_CLIENT_MACHINE, XA_STRING, 256 / 4 },
+        { 0 }, { 0 },
+    };
+    int n = sizeof(req) / sizeof(req[0]) - 2;
+
+    n += rule_properties(&req[n]);
+    be->prefetch_properties(c->win, req, n);
+}
+
 Client* create_client(Window w) {
     Client *c;
     XWindowAttributes wa;
+    bool dialog, positioned = false, requested;
     
-    if (!XGetWindowAttributes(dpy, w, &wa)) {
+    if (!be->get_attributes(w, &wa)) {
         return NULL;
     }
     
@@ -25,26 +218,117 @@ Client* create_client(Window w) {
     c->old_y = c->y;
     c->old_w = c->w;
     c->old_h = c->h;
+    c->bw = config.border_width;
     c->is_floating = false;
     c->is_fullscreen = false;
+    /* Adopted windows that are not viewable get mapped by the first layout */
+    c->is_hidden = wa.map_state != IsViewable;
+    c->hidden_by = HideUnmap;
+    
+    /* Fetch the properties rules match on together, before the client is
+     * attached, so the first layout pass already honors them */
+    prefetch_properties(c);
+    update_title(c);
+    dialog = update_window_type(c);
+    update_window_state(c);
+    update_protocols(c);
+    update_transient(c);
+    /* Also for transients: USPosition says whether to center them */
+    dialog |= is_fixed_size(c, &positioned);
+    dialog |= c->transient_for != None;
+    update_pid(c);
+    c->is_floating |= dialog;
+    requested = c->is_fullscreen;
+    apply_rules(c);
+    be->prefetch_properties(w, NULL, 0);
+    /* A rule turned down the client's own fullscreen request */
+    if (requested && !c->is_fullscreen) {
+        update_net_wm_state(c);
+    }
     
     /* Set border */
-    XSetWindowBorderWidth(dpy, w, config.border_width);
-    XSetWindowBorder(dpy, w, config.border_normal);
+    be->set_border_width(w, c->bw);
+    be->set_border(w, config.border_normal);
     
     /* Set event mask */
-    XSelectInput(dpy, w, EnterWindowMask | FocusChangeMask | PropertyChangeMask | StructureNotifyMask);
+    be->select_input(w, client_event_mask());
+    
+    /* New dialogs open over their parent; adopted ones stay put */
+    if (dialog && c->is_hidden && c->is_floating && !c->is_desktop && !positioned) {
+        place_dialog(c);
+    }
+    
+    overview_redirect(c);
+    
+    /* Asked for by the client or a rule: borderless from the start */
+    if (c->is_fullscreen) {
+        c->is_fullscreen = false;
+        set_fullscreen(c, true);
+    }
     
     return c;
 }
 
+Client* find_client(Window w) {
+    Client *c;
+    
+    for (c = mon->clients; c && c->win != w; c = c->next);
+    return c;
+}
+
+static void mru_unlink(Client *c) {
+    if (c->mru_prev) {
+        c->mru_prev->mru_next = c->mru_next;
+    } else {
+        mon->mru = c->mru_next;
+    }
+    if (c->mru_next) {
+        c->mru_next->mru_prev = c->mru_prev;
+    } else {
+        mon->mru_tail = c->mru_prev;
+    }
+    c->mru_next = c->mru_prev = NULL;
+}
+
+static void mru_push_front(Client *c) {
+    c->mru_prev = NULL;
+    c->mru_next = mon->mru;
+    if (mon->mru) {
+        mon->mru->mru_prev = c;
+    } else {
+        mon->mru_tail = c;
+    }
+    mon->mru = c;
+}
+
 void attach_client(Client *c) {
-    c->next = mon->clients;
-    if (mon->clients) {
-        mon->clients->prev = c;
+    /* Never focused yet: least recently used */
+    c->mru_next = NULL;
+    c->mru_prev = mon->mru_tail;
+    if (mon->mru_tail) {
+        mon->mru_tail->mru_next = c;
+    } else {
+        mon->mru = c;
     }
-    mon->clients = c;
-    c->prev = NULL;
+    mon->mru_tail = c;
+    
+    /* Rules can send a new window to the end of the stack */
+    if (c->to_stack && mon->clients) {
+        Client *last;
+        for (last = mon->clients; last->next; last = last->next);
+        last->next = c;
+        c->prev = last;
+        c->next = NULL;
+    } else {
+        c->next = mon->clients;
+        if (mon->clients) {
+            mon->clients->prev = c;
+        }
+        mon->clients = c;
+        c->prev = NULL;
+    }
+    stack_changed();
+    ipc_window(true, c->win);
 }
 
 void detach_client(Client *c) {
@@ -56,6 +340,15 @@ void detach_client(Client *c) {
     if (c->next) {
         c->next->prev = c->prev;
     }
+    tree_remove(c);
+    mru_unlink(c);
+    overview_forget(c);
+    thaw_client(c);
+    stack_changed();
+    ipc_window(false, c->win);
+    if (mon->cycle == c) {
+        mon->cycle = mon->mru;
+    }
 }
 
 void focus_client(Client *c) {
@@ -63,16 +356,31 @@ void focus_client(Client *c) {
         return;
     }
     
-    /* Unfocus previously selected client */
-    if (mon->selected && mon->selected != c) {
-        XSetWindowBorder(dpy, mon->selected->win, config.border_normal);
-    }
+    trace_begin("focus_client", "focus");
     
-    /* Focus new client */
+    /* Focus new client, then unfocus the previously selected one */
+    Client *prev = mon->selected;
     mon->selected = c;
-    XSetWindowBorder(dpy, c->win, config.border_focus);
-    XSetInputFocus(dpy, c->win, RevertToPointerRoot, CurrentTime);
-    XRaiseWindow(dpy, c->win);
+    if (prev && prev != c) {
+        update_border(prev);
+        overview_unfocus(prev);
+    }
+    /* Focusing a window hidden on request brings it back */
+    if (c->is_iconic) {
+        set_iconic(c, false);
+    }
+    if (mon->mru != c) {
+        mru_unlink(c);
+        mru_push_front(c);
+    }
+    tree_focus(c);
+    boost_focus(c);
+    update_border(c);
+    be->set_focus(c->win);
+    /* Focus reorders its layer only; it never lifts a window above a
+     * fullscreen one */
+    stack_changed();
+    trace_end();
 }
 
 void remove_client(Client *c) {
@@ -82,10 +390,19 @@ void remove_client(Client *c) {
     
     detach_client(c);
     
+    /* Hand focus back to the dialog's parent or the previously focused
+     * window */
     if (mon->selected == c) {
-        mon->selected = mon->clients;
+        Client *p = c->transient_for ? find_client(c->transient_for) : NULL;
+        for (mon->selected = mon->mru; mon->selected && mon->selected->is_iconic;
+             mon->selected = mon->selected->mru_next);
+        if (p && !p->is_iconic) {
+            mon->selected = p;
+        }
         if (mon->selected) {
             focus_client(mon->selected);
+        } else {
+            boost_focus(NULL);
         }
     }
     
@@ -103,10 +420,10 @@ void configure_client(Client *c) {
     ce.y = c->y;
     ce.width = c->w;
     ce.height = c->h;
-    ce.border_width = config.border_width;
+    ce.border_width = c->bw;
     ce.above = None;
     ce.override_redirect = False;
-    XSendEvent(dpy, c->win, False, StructureNotifyMask, (XEvent *)&ce);
+    be->send_event(c->win, StructureNotifyMask, (XEvent *)&ce);
 }
 
 void resize_client(Client *c, int x, int y, int w, int h) {
@@ -119,20 +436,238 @@ void resize_client(Client *c, int x, int y, int w, int h) {
     c->w = w;
     c->h = h;
     
-    XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+    /* A parked window moves once, when show_client() brings it back */
+    if (c->is_hidden && c->hidden_by == HideOffscreen) {
+        return;
+    }
+    
+    be->move_resize(c->win, c->x, c->y, c->w, c->h);
     configure_client(c);
 }
 
+/* A hung window keeps its warning color even while focused */
+void update_border(Client *c) {
+    be->set_border(c->win, c->ping.unresponsive ? config.border_unresponsive :
+                   c == mon->selected ? config.border_focus : config.border_normal);
+}
+
+static void set_client_state(Client *c, long state) {
+    long data[] = { state, None };
+    
+    be->change_property(c->win, wmatom[WMState], wmatom[WMState], 32,
+                        PropModeReplace, (unsigned char *)data, 2);
+}
+
+static bool get_text_property(Window w, Atom prop, Atom type, char *text, size_t size) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    bool found = false;
+    
+    if (be->get_property(w, prop, type, size / 4, &actual_type, &actual_format,
+                         &nitems, &data) == Success && data) {
+        if (actual_format == 8 && nitems > 0) {
+            size_t n = nitems < size - 1 ? nitems : size - 1;
+            memcpy(text, data, n);
+            text[n] = '\0';
+            found = true;
+        }
+        XFree(data);
+    }
+    return found;
+}
+
+void update_title(Client *c) {
+    if (!get_text_property(c->win, netatom[NetWMName], netatom[NetUTF8String],
+                           c->name, sizeof(c->name)) &&
+        !get_text_property(c->win, XA_WM_NAME, AnyPropertyType,
+                           c->name, sizeof(c->name))) {
+        c->name[0] = '\0';
+    }
+}
+
+/* Rewrite _NET_WM_STATE from the client's flags */
+void update_net_wm_state(Client *c) {
+    Atom managed[] = { netatom[NetWMStateFullscreen], netatom[NetWMStateAbove],
+                       netatom[NetWMStateHidden] };
+    bool set[] = { c->is_fullscreen, c->is_above, c->is_hidden };
+    Atom state[STATE_MAX + 3];
+    Atom actual_type;
+    int actual_format, n = 0;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    
+    /* States swm does not manage, e.g. MODAL or a pager's STICKY, stay */
+    if (be->get_property(c->win, netatom[NetWMState], XA_ATOM, STATE_MAX,
+                         &actual_type, &actual_format, &nitems, &data) == Success && data) {
+        for (unsigned long i = 0; i < nitems; i++) {
+            Atom a = ((Atom *)data)[i];
+            bool ours = false;
+            for (int j = 0; j < 3; j++) {
+                ours |= a == managed[j];
+            }
+            if (!ours) {
+                state[n++] = a;
+            }
+        }
+        XFree(data);
+    }
+    for (int j = 0; j < 3; j++) {
+        if (set[j]) {
+            state[n++] = managed[j];
+        }
+    }
+    be->change_property(c->win, netatom[NetWMState], XA_ATOM, 32,
+                        PropModeReplace, (unsigned char *)state, n);
+}
+
+/* Fullscreen covers the tiled set instead of changing it: the others are
+ * not resized, and the window gets its old place back on the way out
+ * unless a layout pass moved things meanwhile */
+void set_fullscreen(Client *c, bool fullscreen) {
+    if (c->is_fullscreen == fullscreen) {
+        return;
+    }
+    c->is_fullscreen = fullscreen;
+    if (fullscreen) {
+        c->old_x = c->x;
+        c->old_y = c->y;
+        c->old_w = c->w;
+        c->old_h = c->h;
+        c->old_bw = c->bw;
+        c->bw = 0;
+        c->fullscreen_pass = mon->passes;
+        be->set_border_width(c->win, 0);
+        resize_client(c, 0, 0, screen_width, screen_height);
+        /* No layout pass will show it */
+        if (!c->is_iconic) {
+            show_client(c);
+        }
+    } else {
+        c->bw = c->old_bw;
+        be->set_border_width(c->win, c->bw);
+        resize_client(c, c->old_x, c->old_y, c->old_w, c->old_h);
+    }
+    update_net_wm_state(c);
+    overview_redirect(c);
+    stack_changed();
+    if (!fullscreen && !c->is_floating && !c->is_iconic &&
+        c->fullscreen_pass != mon->passes) {
+        apply_layout();
+    }
+}
+
+/* Hidden on the client's request: out of the layout until it asks to be
+ * shown or is focused */
+void set_iconic(Client *c, bool iconic) {
+    if (c->is_iconic == iconic) {
+        return;
+    }
+    c->is_iconic = iconic;
+    if (iconic) {
+        hide_client(c);
+        if (mon->selected == c) {
+            for (Client *f = mon->mru; f; f = f->mru_next) {
+                if (!f->is_iconic) {
+                    focus_client(f);
+                    break;
+                }
+            }
+        }
+    } else {
+        show_client(c);
+    }
+    if (!c->is_floating && !c->is_fullscreen) {
+        apply_layout();
+    }
+}
+
+/* _NET_WM_STATE client message, one property of it */
+#define NET_WM_STATE_REMOVE 0
+#define NET_WM_STATE_ADD    1
+#define NET_WM_STATE_TOGGLE 2
+
+void change_net_wm_state(Client *c, long action, Atom state) {
+    bool *flag = NULL, on;
+    
+    if (!state) {
+        return;
+    }
+    if (state == netatom[NetWMStateFullscreen]) {
+        flag = &c->is_fullscreen;
+    } else if (state == netatom[NetWMStateAbove]) {
+        flag = &c->is_above;
+    } else if (state == netatom[NetWMStateHidden]) {
+        flag = &c->is_iconic;
+    }
+    if (!flag || (action != NET_WM_STATE_REMOVE && action != NET_WM_STATE_ADD &&
+                  action != NET_WM_STATE_TOGGLE)) {
+        return;
+    }
+    on = action == NET_WM_STATE_ADD || (action == NET_WM_STATE_TOGGLE && !*flag);
+    if (on == *flag) {
+        return;
+    }
+    if (flag == &c->is_fullscreen) {
+        set_fullscreen(c, on);
+    } else if (flag == &c->is_iconic) {
+        set_iconic(c, on);
+    } else {
+        c->is_above = on;
+        update_net_wm_state(c);
+        stack_changed();
+    }
+}
+
+static HideStrategy hide_strategy(Client *c) {
+    if (c->hide != HideDefault) {
+        return c->hide;
+    }
+    if (mon->layout && mon->layout->hide != HideDefault) {
+        return mon->layout->hide;
+    }
+    return config.hide_strategy;
+}
+
 void show_client(Client *c) {
     if (!c) {
         return;
     }
-    XMapWindow(dpy, c->win);
+    /* Running again before its window is back, also for a new window of
+     * a throttled process */
+    thaw_client(c);
+    if (!c->is_hidden) {
+        return;
+    }
+    
+    c->is_hidden = false;
+    if (c->hidden_by == HideOffscreen) {
+        be->move_resize(c->win, c->x, c->y, c->w, c->h);
+        configure_client(c);
+    } else {
+        be->map(c->win);
+    }
+    set_client_state(c, NormalState);
+    update_net_wm_state(c);
 }
 
 void hide_client(Client *c) {
-    if (!c) {
+    if (!c || c->is_hidden) {
         return;
     }
-    XUnmapWindow(dpy, c->win);
+    
+    c->is_hidden = true;
+    c->hidden_by = hide_strategy(c);
+    if (c->hidden_by == HideOffscreen) {
+        /* Stay mapped so GL and video clients keep their surfaces */
+        be->move_resize(c->win, -2 * (c->w + 2 * c->bw),
+                        c->y, c->w, c->h);
+    } else {
+        c->ignore_unmap++;
+        be->unmap(c->win);
+    }
+    set_client_state(c, IconicState);
+    update_net_wm_state(c);
+    freeze_hidden(c);
 }
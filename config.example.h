@@ -15,9 +15,20 @@
 /* Border width in pixels */
 #define BORDER_WIDTH        3
 
+/* Wallpaper, scaled to cover the screen: binary PPM (P6) or farbfeld,
+ * PNG too when built with make PNG=1.  The scaled pixels are cached in
+ * ~/.cache/swm, so only the first login at a resolution decodes it.
+ * NULL leaves the root window alone (for feh, xsetroot and the like). */
+#define WALLPAPER           NULL
+
+/* Font for the status bar (X logical font description, fontset) */
+#define FONT                "-*-fixed-medium-r-*-*-13-*-*-*-*-*-*-*"
+
 /* Border colors (X11 color names or hex codes) */
 #define BORDER_NORMAL       "#333333"
 #define BORDER_FOCUS        "#0088cc"
+/* Windows that stopped answering _NET_WM_PING */
+#define BORDER_UNRESPONSIVE "#cc3333"
 
 /* Master area factor (0.1 - 0.9) */
 #define MASTER_FACTOR       0.55
@@ -25,6 +36,48 @@
 /* Number of windows in master area */
 #define NUM_MASTER          1
 
+/* How layouts hide the windows they do not show:
+ * - HideOffscreen : keep them mapped but parked outside the screen, so
+ *                   switching back is instant for GL and video clients
+ * - HideUnmap     : unmap them, letting clients free their surfaces */
+#define HIDE_STRATEGY       HideOffscreen
+
+/* Focus the window under the pointer; 0 also stops swm from listening to
+ * pointer crossings at all (toggle at runtime with toggle_focus_mouse) */
+#define FOCUS_FOLLOWS_MOUSE 1
+
+/* Thumbnails for overview() need every window's contents kept offscreen
+ * with XComposite, which costs server memory and a copy per frame, so it
+ * is off unless enabled here.  Fullscreen windows are never redirected. */
+#define OVERVIEW            0
+
+/* Give the focused window's process more CPU than background work: a
+ * higher cpu.weight for its own cgroup (default weight is 100), or else a
+ * lower nice value for its process group (below 0 needs CAP_SYS_NICE).
+ * It goes back to its old value when focus moves on. */
+#define FOCUS_BOOST         0
+#define BOOST_WEIGHT        400
+#define BOOST_NICE          -5
+
+/* Rules with a freeze policy pause (FreezePause) or throttle
+ * (FreezeThrottle, to THROTTLE_PERCENT of one CPU) a process once all its
+ * windows have been hidden for FREEZE_GRACE seconds, e.g. by monocle.
+ * It runs again before any of its windows is shown. */
+#define FREEZE_GRACE        30
+#define THROTTLE_PERCENT    5
+
+/* Seconds between samples of each client's X server resources and pixmap
+ * memory (needs make XRES=1); kill -USR1 samples and prints stats too */
+#define RESOURCE_INTERVAL   300
+
+/* Clients supporting _NET_WM_PING are pinged every PING_INTERVAL seconds
+ * (0: only when killed) and marked unresponsive after PING_TIMEOUT ms
+ * without an answer.  Killing a window again within KILL_TIMEOUT seconds,
+ * while it has not answered, kills its process and X connection. */
+#define PING_INTERVAL       10
+#define PING_TIMEOUT        2000
+#define KILL_TIMEOUT        5
+
 /* ============================================
  * MODKEY
  * ============================================ */
@@ -39,6 +92,39 @@
 #define TRAY_HEIGHT         24
 #define TRAY_WIDTH          300
 
+/* Background threads for process launching and status modules;
+ * 0 runs that work on the X event thread */
+#define WORKERS             2
+
+/* ============================================
+ * STATUS BAR
+ * ============================================
+ * Drawn in the strip reserved for the tray, left of the tray window:
+ * layout name, focused window title, then the modules below. */
+
+#define SHOW_BAR            1
+#define BAR_FG              "#bbbbbb"
+#define BAR_BG              "#222222"
+
+/* Format: { function, argument, interval (seconds), watched file }
+ *
+ * A module is refreshed every interval seconds (aligned to the interval,
+ * so 60 ticks on the minute) and/or whenever the watched file is written.
+ *
+ * Available functions:
+ * - status_clock(strftime format)
+ * - status_load()           : 1-minute load average
+ * - status_mem()            : memory in use
+ * - status_file(path)       : first line of a file, e.g. written by a script
+ */
+static const BarModule modules[] = {
+    /* function      argument                interval  watch */
+    { status_file,   "~/.cache/swm/status",  0,        "~/.cache/swm/status" },
+    { status_load,   NULL,                   15,       NULL },
+    { status_mem,    NULL,                   15,       NULL },
+    { status_clock,  "%a %d %b %H:%M",       60,       NULL },
+};
+
 /* ============================================
  * KEY BINDINGS
  * ============================================
@@ -59,7 +145,15 @@
  * - quit_wm()               : Exit window manager
  * - focus_next()            : Focus next window
  * - focus_prev()            : Focus previous window
- * - set_master_factor(val)  : Adjust master area size (+0.05 or -0.05)
+ * - toggle_focus_mouse()    : Turn focus-follows-mouse on or off
+ * - launcher()              : Prompt for a program from $PATH; Tab completes,
+ *                             Left/Right pick among the matches
+ * - overview()              : Show all windows as thumbnails; click one or
+ *                             type part of its title to focus it
+ * - focus_mru(dir)          : Cycle through recently focused windows while
+ *                             the modifier is held ("-1" goes backwards)
+ * - set_master_factor(val)  : Adjust master area size (+0.05 or -0.05);
+ *                             in bsp/spiral/dwindle, the focused window's split
  * - inc_num_master()        : Increase master window count
  * - dec_num_master()        : Decrease master window count
  * - toggle_floating()       : Toggle floating mode
@@ -72,7 +166,7 @@ static KeyBinding keys[] = {
     
     /* Application launchers */
     { MODKEY,                XK_Return,         spawn,                "xterm" },
-    { MODKEY,                XK_d,              spawn,                "dmenu_run" },
+    { MODKEY,                XK_d,              launcher,             NULL },
     { MODKEY,                XK_w,              spawn,                "firefox" },
     { MODKEY,                XK_e,              spawn,                "thunar" },
     
@@ -80,8 +174,12 @@ static KeyBinding keys[] = {
     { MODKEY,                XK_q,              kill_client,          NULL },
     { MODKEY,                XK_j,              focus_next,           NULL },
     { MODKEY,                XK_k,              focus_prev,           NULL },
+    { MODKEY,                XK_Tab,            focus_mru,            NULL },
+    { MODKEY|ShiftMask,      XK_Tab,            focus_mru,            "-1" },
     { MODKEY,                XK_f,              toggle_fullscreen,    NULL },
     { MODKEY,                XK_space,          toggle_floating,      NULL },
+    { MODKEY|ShiftMask,      XK_f,              toggle_focus_mouse,   NULL },
+    { MODKEY,                XK_a,              overview,             NULL },
     
     /* Layout control */
     { MODKEY,                XK_h,              set_master_factor,    "-0.05" },
@@ -94,16 +192,45 @@ static KeyBinding keys[] = {
     { MODKEY,                XK_m,              set_layout,           "monocle" },
     { MODKEY,                XK_g,              set_layout,           "grid" },
     { MODKEY,                XK_s,              set_layout,           "floating" },
+    { MODKEY,                XK_b,              set_layout,           "bsp" },
+    { MODKEY,                XK_v,              set_layout,           "spiral" },
+    { MODKEY,                XK_n,              set_layout,           "dwindle" },
     
     /* System */
     { MODKEY|ShiftMask,      XK_q,              quit_wm,              NULL },
     { MODKEY|ShiftMask,      XK_r,              spawn,                "swm" }, /* Restart WM */
 };
 
+/* ============================================
+ * WINDOW RULES
+ * ============================================
+ * Applied when a window is mapped, before it is first laid out.
+ * NULL matches anything; class, instance and role must match exactly,
+ * title matches as a substring. Find the values with xprop:
+ *   WM_CLASS(STRING) = instance, class
+ *   WM_WINDOW_ROLE(STRING) = role
+ *
+ * master: 1 makes the window the new master, 0 appends it to the stack,
+ *         -1 keeps the default (new windows become master)
+ * border: border width in pixels, -1 keeps BORDER_WIDTH
+ * freeze: FreezeNone, or FreezePause / FreezeThrottle for hidden windows
+ */
+static const Rule rules[] = {
+    /* class        instance  title  role           float  full   master  hide           border  freeze */
+    { "Gimp",       NULL,     NULL,  NULL,          1,     -1,    -1,     HideDefault,   -1,     FreezeNone },
+    { "Pavucontrol",NULL,     NULL,  NULL,          1,     -1,    -1,     HideDefault,   -1,     FreezeNone },
+    { "firefox",    NULL,     NULL,  "PictureInPicture", 1, -1,   -1,     HideDefault,   0,      FreezeNone },
+    { "mpv",        NULL,     NULL,  NULL,          -1,    -1,    -1,     HideOffscreen, -1,     FreezeNone },
+    { NULL,         NULL,     NULL,  "pop-up",      1,     -1,    -1,     HideDefault,   -1,     FreezeNone },
+    /* Opt in per application, e.g. to throttle a chat client in monocle:
+    { "Slack",      NULL,     NULL,  NULL,          -1,    -1,    -1,     HideDefault,   -1,     FreezeThrottle }, */
+};
+
 /* ============================================
  * TILING LAYOUTS
  * ============================================
- * Format: { name, layout_function }
+ * Format: { name, layout_function, hide_strategy }
+ * HideDefault uses HIDE_STRATEGY
  * 
  * Available layouts:
  * - tile_layout      : Master/stack tiling
@@ -115,10 +242,14 @@ static KeyBinding keys[] = {
  */
 
 static TilingLayout layouts[] = {
-    { "tile",     tile_layout },
-    { "monocle",  monocle_layout },
-    { "floating", floating_layout },
-    { "grid",     grid_layout },
+    /* name       function          hide_strategy */
+    { "tile",     tile_layout,      HideDefault },
+    { "monocle",  monocle_layout,   HideDefault },
+    { "floating", floating_layout,  HideDefault },
+    { "grid",     grid_layout,      HideDefault },
+    { "bsp",      bsp_layout,       HideDefault },
+    { "spiral",   spiral_layout,    HideDefault },
+    { "dwindle",  dwindle_layout,   HideDefault },
 };
 
 #endif /* CONFIG_H */
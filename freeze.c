@@ -0,0 +1,278 @@
+/*
+ * Hidden Window Freezing
+ *
+ * Processes whose windows a rule marks with a freeze policy are paused,
+ * or throttled, once their windows have been hidden for FREEZE_GRACE
+ * seconds.  Pausing uses the cgroup v2 freezer when the process has a
+ * cgroup of its own and SIGSTOP on its process group otherwise;
+ * throttling sets a cpu.max quota and needs the cgroup.  That cgroup or
+ * group is the unit: it is frozen only once every window of every process
+ * in it is hidden, and thawed before show_client() maps any of them.
+ * CPU time saved is estimated from the rate the process used while its
+ * windows were hidden but it still ran, minus what it used while frozen.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "swm.h"
+
+#define FROZEN_MAX      64
+
+/* A frozen unit: a cgroup, else a process group, else one process */
+typedef struct {
+    pid_t pid;                  /* 0 for a free slot */
+    FreezePolicy policy;
+    char cgroup[600];           /* empty: paused with SIGSTOP */
+    pid_t pgid;                 /* 0: only pid is signalled */
+    char old_max[64];           /* cpu.max before throttling */
+    long long since_ns;
+    long long usage_us;         /* CPU used up to the freeze */
+    double rate;                /* CPU seconds per second while hidden */
+} Frozen;
+
+static void on_timer(int fd, short revents);
+
+static Frozen frozen[FROZEN_MAX];
+static Deadline timer = { -1, 0, on_timer };
+
+/* CPU the process used so far: its cgroup's total when it has one */
+static long long usage_us(pid_t pid) {
+    char dir[600], buf[64], path[64], line[1024], *p;
+    unsigned long long utime, stime;
+    long long usage = -1;
+    FILE *fp;
+
+    if (cgroup_dir(pid, dir, sizeof(dir)) &&
+        cgroup_read(dir, "cpu.stat", buf, sizeof(buf)) &&
+        sscanf(buf, "usage_usec %lld", &usage) == 1) {
+        return usage;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (!(fp = fopen(path, "r"))) {
+        return -1;
+    }
+    /* The command name may contain anything; fields resume after ')' */
+    if (fgets(line, sizeof(line), fp) && (p = strrchr(line, ')')) &&
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+               &utime, &stime) == 2) {
+        usage = (long long)(utime + stime) * 1000000 / sysconf(_SC_CLK_TCK);
+    }
+    fclose(fp);
+    return usage;
+}
+
+/* What pausing pid acts on: its own cgroup when the freezer (or, for
+ * throttling, cpu.max) is there, else its process group unless that is
+ * swm's own, else the process alone */
+static void find_unit(pid_t pid, FreezePolicy policy, Frozen *u) {
+    char path[640];
+
+    memset(u, 0, sizeof(*u));
+    u->pid = pid;
+    u->policy = policy;
+    if (cgroup_dir(pid, u->cgroup, sizeof(u->cgroup))) {
+        snprintf(path, sizeof(path), "%s/%s", u->cgroup,
+                 policy == FreezeThrottle ? "cpu.max" : "cgroup.freeze");
+        if (access(path, W_OK) == 0) {
+            return;
+        }
+        u->cgroup[0] = '\0';
+    }
+    if (policy != FreezeThrottle && (u->pgid = getpgid(pid)) > 0 && u->pgid != getpgrp()) {
+        return;
+    }
+    u->pgid = 0;
+}
+
+static bool in_unit(const Frozen *u, pid_t pid) {
+    char dir[600];
+
+    if (!pid) {
+        return false;
+    }
+    if (pid == u->pid) {
+        return true;
+    }
+    if (u->cgroup[0]) {
+        return cgroup_dir(pid, dir, sizeof(dir)) && !strcmp(dir, u->cgroup);
+    }
+    return u->pgid && getpgid(pid) == u->pgid;
+}
+
+static Frozen *find_frozen(pid_t pid) {
+    for (int i = 0; i < FROZEN_MAX; i++) {
+        if (frozen[i].pid && in_unit(&frozen[i], pid)) {
+            return &frozen[i];
+        }
+    }
+    return NULL;
+}
+
+static bool pause_process(Frozen *f) {
+    char quota[64];
+
+    if (f->policy == FreezeThrottle) {
+        snprintf(quota, sizeof(quota), "%d 100000", config.throttle_percent * 1000);
+        return f->cgroup[0] &&
+               cgroup_read(f->cgroup, "cpu.max", f->old_max, sizeof(f->old_max)) &&
+               cgroup_write(f->cgroup, "cpu.max", quota);
+    }
+    if (f->cgroup[0]) {
+        return cgroup_write(f->cgroup, "cgroup.freeze", "1");
+    }
+    return kill(f->pgid ? -f->pgid : f->pid, SIGSTOP) == 0;
+}
+
+static void resume_process(Frozen *f) {
+    if (f->policy == FreezeThrottle) {
+        cgroup_write(f->cgroup, "cpu.max", f->old_max);
+    } else if (f->cgroup[0]) {
+        cgroup_write(f->cgroup, "cgroup.freeze", "0");
+    } else {
+        kill(f->pgid ? -f->pgid : f->pid, SIGCONT);
+    }
+}
+
+static void thaw(Frozen *f) {
+    long long used = usage_us(f->pid);
+    double secs = (now_ns() - f->since_ns) / 1e9;
+
+    resume_process(f);
+    if (used >= 0) {
+        double saved = f->rate * secs - (used - f->usage_us) / 1e6;
+        if (saved > 0) {
+            stats.freeze_saved_ms += saved * 1000;
+        }
+    }
+    stats.thaws++;
+    f->pid = 0;
+}
+
+/* Freezable once every window in the unit is hidden; returns when the
+ * last of them was hidden, or -1 */
+static long long hidden_since(const Frozen *u, Client **first) {
+    long long latest = 0;
+
+    *first = NULL;
+    for (Client *c = mon->clients; c; c = c->next) {
+        if (!in_unit(u, c->pid)) {
+            continue;
+        }
+        if (!c->is_hidden || !c->freeze) {
+            return -1;
+        }
+        if (c->hidden_ns > latest) {
+            latest = c->hidden_ns;
+        }
+        if (!*first || c->hidden_ns < (*first)->hidden_ns) {
+            *first = c;
+        }
+    }
+    return *first ? latest : -1;
+}
+
+static void freeze(const Frozen *unit, Client *c, long long now) {
+    Frozen *f = NULL;
+    double hidden = (now - c->hidden_ns) / 1e9;
+    long long used = usage_us(c->pid);
+
+    for (int i = 0; !f && i < FROZEN_MAX; i++) {
+        if (!frozen[i].pid) {
+            f = &frozen[i];
+        }
+    }
+    if (!f || used < 0) {
+        return;
+    }
+    *f = *unit;
+    trace_begin("freeze", "freeze");
+    if (!pause_process(f)) {
+        f->pid = 0;
+        stats.freeze_failures++;
+        trace_end();
+        return;
+    }
+    trace_end();
+    for (Client *w = mon->clients; w; w = w->next) {
+        if (in_unit(f, w->pid)) {
+            cancel_ping(w);
+        }
+    }
+    f->since_ns = now;
+    f->usage_us = used;
+    f->rate = hidden > 0 && c->hidden_usage_us >= 0 ?
+              (used - c->hidden_usage_us) / 1e6 / hidden : 0;
+    stats.freezes++;
+}
+
+/* Freeze whatever has been hidden long enough, then wait for the next */
+static void on_timer(int fd, short revents) {
+    long long now = now_ns(), grace = config.freeze_grace * 1000000000LL;
+    long long next = 0;
+    Client *first;
+
+    (void)fd;
+    (void)revents;
+    if (!deadline_expired(&timer)) {
+        return;
+    }
+    for (Client *c = mon->clients; c; c = c->next) {
+        Frozen unit;
+        long long since;
+        if (!c->freeze || !c->pid || !c->is_hidden || find_frozen(c->pid)) {
+            continue;
+        }
+        find_unit(c->pid, c->freeze, &unit);
+        if ((since = hidden_since(&unit, &first)) < 0 || first != c) {
+            continue;
+        }
+        if (now - since >= grace) {
+            freeze(&unit, c, now);
+        } else if (!next || since + grace < next) {
+            next = since + grace;
+        }
+    }
+    if (next) {
+        arm_deadline(&timer, next);
+    }
+}
+
+/* Called from hide_client() */
+void freeze_hidden(Client *c) {
+    if (!c->freeze || !c->pid) {
+        return;
+    }
+    c->hidden_ns = now_ns();
+    c->hidden_usage_us = usage_us(c->pid);
+    arm_deadline(&timer, c->hidden_ns + config.freeze_grace * 1000000000LL);
+}
+
+/* Before the client's window is mapped, moved back or destroyed; any
+ * window in a frozen unit thaws it, whatever its own policy */
+void thaw_client(Client *c) {
+    Frozen *f;
+
+    if ((f = find_frozen(c->pid))) {
+        trace_begin("thaw", "freeze");
+        thaw(f);
+        trace_end();
+    }
+}
+
+bool client_frozen(Client *c) {
+    return find_frozen(c->pid) != NULL;
+}
+
+void thaw_all(void) {
+    for (int i = 0; i < FROZEN_MAX; i++) {
+        if (frozen[i].pid) {
+            thaw(&frozen[i]);
+        }
+    }
+    stop_deadline(&timer);
+}
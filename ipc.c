@@ -0,0 +1,389 @@
+/*
+ * Event Subscription Socket
+ *
+ * Tools connect to a Unix socket, send "subscribe <class>..." and then
+ * receive one line per change instead of polling X.  Classes:
+ *
+ *   focus   focus <window> <title>       layout  layout <name>
+ *   map     map <window>                 mfact   mfact <factor> <num_master>
+ *   unmap   unmap <window>               tray    tray <icons>
+ *
+ * Writes never block.  State classes are coalesced: a subscriber that
+ * falls behind gets the latest value once, not every intermediate one.
+ * map/unmap go through a small per-subscriber queue; when it is full new
+ * records are dropped, counted, and reported as "dropped <n>" once the
+ * subscriber catches up.  Control characters in titles are sent as
+ * spaces, so a title can never start a record of its own.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "swm.h"
+
+#define IPC_SUBSCRIBERS 16
+#define IPC_QUEUE       64
+#define IPC_LINE        320
+
+enum { IpcFocus, IpcMap, IpcUnmap, IpcLayout, IpcMfact, IpcTray, IpcLast };
+
+static const char *class_names[IpcLast] = {
+    "focus", "map", "unmap", "layout", "mfact", "tray",
+};
+
+typedef struct {
+    int kind;
+    Window win;
+} IpcRecord;
+
+typedef struct {
+    int fd;
+    unsigned int mask;              /* subscribed classes */
+    unsigned int pending;           /* state classes to send, coalesced */
+    IpcRecord queue[IPC_QUEUE];     /* map/unmap, in order */
+    int queue_head, queue_len;
+    unsigned long dropped;          /* not yet reported to the subscriber */
+    char in[IPC_LINE];
+    size_t in_len;
+    char out[IPC_LINE];
+    size_t out_len, out_off;
+} Subscriber;
+
+static Subscriber *subs[IPC_SUBSCRIBERS];
+static int listen_fd = -1;
+static char socket_path[108];
+
+/* Last published state, to notice changes once per drain */
+static Window last_focus;
+static char last_title[256];
+static const TilingLayout *last_layout;
+static float last_mfact;
+static int last_nmaster;
+static int last_tray = -1;
+
+static void drop_subscriber(Subscriber *s) {
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        if (subs[i] == s) {
+            subs[i] = NULL;
+        }
+    }
+    unwatch_fd(s->fd);
+    close(s->fd);
+    free(s);
+}
+
+static int tray_icons(void) {
+    int n = 0;
+
+    for (TrayClient *tc = tray ? tray->clients : NULL; tc; tc = tc->next) {
+        n++;
+    }
+    return n;
+}
+
+/* Format the next record into the output buffer; false when idle */
+static bool next_record(Subscriber *s) {
+    char *buf = s->out;
+    int len = 0;
+
+    if (s->dropped) {
+        len = snprintf(buf, IPC_LINE, "dropped %lu\n", s->dropped);
+        s->dropped = 0;
+    } else if (s->queue_len) {
+        IpcRecord *r = &s->queue[s->queue_head];
+        len = snprintf(buf, IPC_LINE, "%s 0x%lx\n", class_names[r->kind], r->win);
+        s->queue_head = (s->queue_head + 1) % IPC_QUEUE;
+        s->queue_len--;
+    } else if (s->pending & (1u << IpcFocus)) {
+        s->pending &= ~(1u << IpcFocus);
+        len = snprintf(buf, IPC_LINE, "focus 0x%lx %s\n", last_focus, last_title);
+    } else if (s->pending & (1u << IpcLayout)) {
+        s->pending &= ~(1u << IpcLayout);
+        len = snprintf(buf, IPC_LINE, "layout %s\n", last_layout ? last_layout->name : "");
+    } else if (s->pending & (1u << IpcMfact)) {
+        s->pending &= ~(1u << IpcMfact);
+        len = snprintf(buf, IPC_LINE, "mfact %.2f %d\n", last_mfact, last_nmaster);
+    } else if (s->pending & (1u << IpcTray)) {
+        s->pending &= ~(1u << IpcTray);
+        len = snprintf(buf, IPC_LINE, "tray %d\n", last_tray);
+    } else {
+        return false;
+    }
+    if (len >= IPC_LINE) {
+        /* Titles are cut, the record still ends the line */
+        len = IPC_LINE - 1;
+        buf[len - 1] = '\n';
+    }
+    s->out_len = len;
+    s->out_off = 0;
+    return true;
+}
+
+static void on_subscriber(int fd, short revents);
+
+/* Write as much as the socket takes without blocking */
+static void flush(Subscriber *s) {
+    for (;;) {
+        if (s->out_off == s->out_len && !next_record(s)) {
+            watch_fd(s->fd, POLLIN, on_subscriber);
+            return;
+        }
+        ssize_t n = send(s->fd, s->out + s->out_off, s->out_len - s->out_off,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                /* Resume when the reader catches up */
+                watch_fd(s->fd, POLLIN | POLLOUT, on_subscriber);
+            } else {
+                drop_subscriber(s);
+            }
+            return;
+        }
+        s->out_off += n;
+    }
+}
+
+static void mark(unsigned int changed);
+static unsigned int note_changes(void);
+
+static void subscribe(Subscriber *s, char *line) {
+    char *word, *save;
+
+    if (!(word = strtok_r(line, " \t", &save)) || strcmp(word, "subscribe") != 0) {
+        return;
+    }
+    while ((word = strtok_r(NULL, " \t", &save))) {
+        for (int i = 0; i < IpcLast; i++) {
+            if (!strcmp(word, class_names[i]) || !strcmp(word, "all")) {
+                s->mask |= 1u << i;
+            }
+        }
+    }
+    /* Start with the current value of every state class */
+    mark(note_changes());
+    s->pending = s->mask & ~((1u << IpcMap) | (1u << IpcUnmap));
+}
+
+static void on_subscriber(int fd, short revents) {
+    Subscriber *s = NULL;
+
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        if (subs[i] && subs[i]->fd == fd) {
+            s = subs[i];
+        }
+    }
+    if (!s) {
+        return;
+    }
+    if (revents & POLLIN) {
+        ssize_t n = recv(fd, s->in + s->in_len, sizeof(s->in) - 1 - s->in_len, MSG_DONTWAIT);
+        if (n <= 0) {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                drop_subscriber(s);
+            }
+            return;
+        }
+        s->in_len += n;
+        s->in[s->in_len] = '\0';
+
+        char *line = s->in, *nl;
+        while ((nl = strchr(line, '\n'))) {
+            *nl = '\0';
+            subscribe(s, line);
+            line = nl + 1;
+        }
+        s->in_len = strlen(line);
+        memmove(s->in, line, s->in_len + 1);
+        if (s->in_len == sizeof(s->in) - 1) {
+            s->in_len = 0;
+        }
+    } else if (revents & (POLLHUP | POLLERR)) {
+        drop_subscriber(s);
+        return;
+    }
+    flush(s);
+}
+
+static void on_accept(int fd, short revents) {
+    int cfd;
+
+    (void)revents;
+    if ((cfd = accept(fd, NULL, NULL)) < 0) {
+        return;
+    }
+    fcntl(cfd, F_SETFD, FD_CLOEXEC);
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        if (!subs[i]) {
+            subs[i] = calloc(1, sizeof(Subscriber));
+            subs[i]->fd = cfd;
+            watch_fd(cfd, POLLIN, on_subscriber);
+            return;
+        }
+    }
+    close(cfd);
+}
+
+bool ipc_enabled(void) {
+    return listen_fd >= 0;
+}
+
+/* Whether another swm still listens on the path; a socket file nobody
+ * accepts on is left over from one that died */
+static bool in_use(const struct sockaddr_un *addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool used;
+
+    if (fd < 0) {
+        return false;
+    }
+    used = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0 ||
+           (errno != ECONNREFUSED && errno != ENOENT);
+    close(fd);
+    return used;
+}
+
+void create_ipc(void) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    const char *display = getenv("DISPLAY");
+    struct sockaddr_un addr;
+    mode_t mask;
+    int ok;
+
+    snprintf(socket_path, sizeof(socket_path), "%s/swm-%s.sock",
+             dir ? dir : "/tmp", display ? display : "none");
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    if (in_use(&addr)) {
+        fprintf(stderr, "swm: %s is in use by another instance\n", socket_path);
+        socket_path[0] = '\0';
+        return;
+    }
+    if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return;
+    }
+    fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+    unlink(socket_path);
+    /* Titles are as private as the snapshot: owner only, even in /tmp */
+    mask = umask(077);
+    ok = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (ok < 0 || listen(listen_fd, 8) < 0) {
+        fprintf(stderr, "swm: cannot listen on %s\n", socket_path);
+        close(listen_fd);
+        listen_fd = -1;
+        return;
+    }
+    watch_fd(listen_fd, POLLIN, on_accept);
+}
+
+void destroy_ipc(void) {
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        if (subs[i]) {
+            drop_subscriber(subs[i]);
+        }
+    }
+    if (listen_fd >= 0) {
+        unwatch_fd(listen_fd);
+        close(listen_fd);
+        unlink(socket_path);
+        listen_fd = -1;
+    }
+}
+
+/* map/unmap records, queued in order */
+void ipc_window(bool mapped, Window win) {
+    int kind = mapped ? IpcMap : IpcUnmap;
+
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        Subscriber *s = subs[i];
+        if (!s || !(s->mask & (1u << kind))) {
+            continue;
+        }
+        if (s->queue_len == IPC_QUEUE) {
+            s->dropped++;
+            stats.ipc_dropped++;
+            continue;
+        }
+        s->queue[(s->queue_head + s->queue_len) % IPC_QUEUE] = (IpcRecord){ kind, win };
+        s->queue_len++;
+    }
+}
+
+static void mark(unsigned int changed) {
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        Subscriber *s = subs[i];
+        unsigned int wanted;
+        if (!s || !(wanted = changed & s->mask)) {
+            continue;
+        }
+        if (s->pending & wanted) {
+            stats.ipc_coalesced++;
+        }
+        s->pending |= wanted;
+    }
+}
+
+/* Compare with the last published state */
+static unsigned int note_changes(void) {
+    unsigned int changed = 0;
+    Window focus = mon->selected ? mon->selected->win : None;
+    char title[sizeof(last_title)];
+    int icons;
+
+    snprintf(title, sizeof(title), "%s", mon->selected ? mon->selected->name : "");
+    for (char *p = title; *p; p++) {
+        if ((unsigned char)*p < 0x20 || *p == 0x7f) {
+            *p = ' ';
+        }
+    }
+    if (focus != last_focus || strcmp(title, last_title) != 0) {
+        last_focus = focus;
+        memcpy(last_title, title, sizeof(last_title));
+        changed |= 1u << IpcFocus;
+    }
+    if (mon->layout != last_layout) {
+        last_layout = mon->layout;
+        changed |= 1u << IpcLayout;
+    }
+    if (mon->master_factor != last_mfact || mon->num_master != last_nmaster) {
+        last_mfact = mon->master_factor;
+        last_nmaster = mon->num_master;
+        changed |= 1u << IpcMfact;
+    }
+    if ((icons = tray_icons()) != last_tray) {
+        last_tray = icons;
+        changed |= 1u << IpcTray;
+    }
+    return changed;
+}
+
+/* Once per event drain: note what changed and push it out */
+void update_ipc(void) {
+    unsigned int changed;
+
+    if (listen_fd < 0 || !mon) {
+        return;
+    }
+    if ((changed = note_changes())) {
+        mark(changed);
+    }
+    for (int i = 0; i < IPC_SUBSCRIBERS; i++) {
+        Subscriber *s = subs[i];
+        if (s && (s->pending || s->queue_len || s->dropped) && s->out_off == s->out_len) {
+            flush(s);
+        }
+    }
+}
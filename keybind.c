@@ -2,47 +2,72 @@
  * Keyboard Binding and Actions
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <X11/Xatom.h>
 #include "swm.h"
 
 void grab_keys(void) {
-    XUngrabKey(dpy, AnyKey, AnyModifier, root);
+    trace_begin("grab_keys", "keys");
+    be->ungrab_keys();
     
     for (int i = 0; i < config.num_keys; i++) {
-        KeyCode code = XKeysymToKeycode(dpy, config.keys[i].keysym);
-        if (code) {
-            XGrabKey(dpy, code, config.keys[i].mod, root,
-                    True, GrabModeAsync, GrabModeAsync);
-            /* Also grab with numlock */
-            XGrabKey(dpy, code, config.keys[i].mod | Mod2Mask, root,
-                    True, GrabModeAsync, GrabModeAsync);
-            /* Also grab with capslock */
-            XGrabKey(dpy, code, config.keys[i].mod | LockMask, root,
-                    True, GrabModeAsync, GrabModeAsync);
-            /* Also grab with both */
-            XGrabKey(dpy, code, config.keys[i].mod | Mod2Mask | LockMask, root,
-                    True, GrabModeAsync, GrabModeAsync);
+        KeySym keysym = config.keys[i].keysym;
+        be->grab_key(keysym, config.keys[i].mod);
+        /* Also grab with numlock */
+        be->grab_key(keysym, config.keys[i].mod | Mod2Mask);
+        /* Also grab with capslock */
+        be->grab_key(keysym, config.keys[i].mod | LockMask);
+        /* Also grab with both */
+        be->grab_key(keysym, config.keys[i].mod | Mod2Mask | LockMask);
+    }
+    trace_end();
+}
+
+/* Runs on a worker: fork twice so the command is adopted by init and
+ * never lingers as a zombie of swm */
+static void spawn_job(void *arg) {
+    char *cmd = arg;
+    pid_t pid = fork();
+    
+    if (pid == 0) {
+        sigset_t empty;
+        setsid();
+        /* Workers run with SIGUSR1 and SIGUSR2 blocked for signalfd, and
+         * the mask would survive exec */
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+        if (fork() == 0) {
+            execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+            /* Only async-signal-safe calls after fork in a threaded process */
+            write(STDERR_FILENO, "swm: execl failed\n", 18);
+            _exit(EXIT_FAILURE);
         }
+        _exit(EXIT_SUCCESS);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
     }
 }
 
+/* Also runs for a spawn dropped at shutdown */
+static void spawn_done(void *arg) {
+    free(arg);
+}
+
 void spawn(const char *arg) {
-    if (!arg) {
-        return;
-    }
+    char *cmd;
     
-    if (fork() == 0) {
-        if (dpy) {
-            close(ConnectionNumber(dpy));
-        }
-        setsid();
-        execl("/bin/sh", "sh", "-c", arg, (char *)NULL);
-        fprintf(stderr, "swm: execl '%s' failed\n", arg);
-        exit(EXIT_SUCCESS);
+    if (!arg || !(cmd = strdup(arg))) {
+        return;
     }
+    queue_job(spawn_job, spawn_done, cmd);
 }
 
 void quit_wm(const char *arg) {
@@ -51,39 +76,26 @@ void quit_wm(const char *arg) {
 }
 
 void kill_client(const char *arg) {
-    (void)arg;
+    Client *c = mon->selected;
+    XEvent ev;
     
-    if (!mon->selected) {
+    (void)arg;
+    if (!c || kill_pending(c)) {
         return;
     }
     
-    XEvent ev;
-    Atom wm_protocols = XInternAtom(dpy, "WM_PROTOCOLS", False);
-    Atom wm_delete = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
-    Atom *protocols;
-    int count;
-    int supports_delete = 0;
-    
-    if (XGetWMProtocols(dpy, mon->selected->win, &protocols, &count)) {
-        for (int i = 0; i < count; i++) {
-            if (protocols[i] == wm_delete) {
-                supports_delete = 1;
-                break;
-            }
-        }
-        XFree(protocols);
-    }
-    
-    if (supports_delete) {
+    if (c->can_delete) {
         ev.type = ClientMessage;
-        ev.xclient.window = mon->selected->win;
-        ev.xclient.message_type = wm_protocols;
+        ev.xclient.window = c->win;
+        ev.xclient.message_type = wmatom[WMProtocols];
         ev.xclient.format = 32;
-        ev.xclient.data.l[0] = wm_delete;
+        ev.xclient.data.l[0] = wmatom[WMDelete];
         ev.xclient.data.l[1] = CurrentTime;
-        XSendEvent(dpy, mon->selected->win, False, NoEventMask, &ev);
+        be->send_event(c->win, NoEventMask, &ev);
+        /* Tells a busy client from a hung one should this be repeated */
+        ping_client(c);
     } else {
-        XKillClient(dpy, mon->selected->win);
+        be->kill(c->win);
     }
 }
 
@@ -111,6 +123,7 @@ void toggle_floating(const char *arg) {
         mon->selected->old_h = mon->selected->h;
     }
     
+    stack_changed();
     apply_layout();
 }
 
@@ -121,25 +134,14 @@ void toggle_fullscreen(const char *arg) {
         return;
     }
     
-    mon->selected->is_fullscreen = !mon->selected->is_fullscreen;
+    set_fullscreen(mon->selected, !mon->selected->is_fullscreen);
+}
+
+void toggle_focus_mouse(const char *arg) {
+    (void)arg;
     
-    if (mon->selected->is_fullscreen) {
-        /* Save old geometry */
-        mon->selected->old_x = mon->selected->x;
-        mon->selected->old_y = mon->selected->y;
-        mon->selected->old_w = mon->selected->w;
-        mon->selected->old_h = mon->selected->h;
-        resize_client(mon->selected, 0, 0, screen_width, screen_height);
-        XRaiseWindow(dpy, mon->selected->win);
-    } else {
-        /* Restore old geometry */
-        resize_client(mon->selected,
-            mon->selected->old_x,
-            mon->selected->old_y,
-            mon->selected->old_w,
-            mon->selected->old_h);
-        apply_layout();
-    }
+    config.focus_mouse = !config.focus_mouse;
+    update_event_masks();
 }
 
 void focus_next(const char *arg) {
@@ -162,12 +164,75 @@ void focus_prev(const char *arg) {
     focus_client(mon->selected->prev);
 }
 
+/* Alt-tab style: walk the focus history while the modifier is held,
+ * marking the candidate with the focus border only.  Focus and raise
+ * happen once, when the modifier is released. */
+static bool cycling;
+
+static void commit_focus(Client *c) {
+    focus_client(c);
+    /* Monocle only shows the selected window */
+    if (c->is_hidden) {
+        apply_layout();
+    }
+}
+
+void focus_mru(const char *arg) {
+    bool backward = arg && atoi(arg) < 0;
+    Client *c;
+    
+    if (!mon->mru || !mon->mru->mru_next) {
+        return;
+    }
+    
+    if (!cycling) {
+        /* Modifier already released: a quick tap goes to the previous window */
+        if (!be->grab_keyboard()) {
+            commit_focus(backward ? mon->mru_tail : mon->mru->mru_next);
+            return;
+        }
+        cycling = true;
+        mon->cycle = mon->mru;
+    }
+    
+    c = backward ? mon->cycle->mru_prev : mon->cycle->mru_next;
+    if (!c) {
+        c = backward ? mon->mru_tail : mon->mru;
+    }
+    be->set_border(mon->cycle->win, config.border_normal);
+    be->set_border(c->win, config.border_focus);
+    mon->cycle = c;
+}
+
+void end_focus_cycle(void) {
+    Client *c = mon->cycle;
+    
+    if (!cycling) {
+        return;
+    }
+    cycling = false;
+    mon->cycle = NULL;
+    be->ungrab_keyboard();
+    if (c) {
+        commit_focus(c);
+    }
+}
+
 void set_master_factor(const char *arg) {
     if (!arg) {
         return;
     }
     
     float delta = atof(arg);
+    
+    /* Split tree layouts resize the focused window's own split */
+    if (is_tree_layout(mon->layout)) {
+        if (tree_resize(mon->selected, delta)) {
+            apply_layout();
+        }
+        return;
+    }
+    
     float new_factor = mon->master_factor + delta;
     
     if (new_factor >= 0.1 && new_factor <= 0.9) {
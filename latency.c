@@ -0,0 +1,332 @@
+/*
+ * Key Binding Latency Benchmark
+ *
+ * Drives a running swm from the outside: maps a few windows of its own,
+ * then injects every binding in config.h's keys[] with XTest and times
+ * how long swm takes to produce the request the binding is for, as seen
+ * by a separate client -- a ConfigureNotify for layout and geometry
+ * changes, a FocusIn for focus changes, a MapNotify for spawned windows,
+ * the overview and the launcher.  Bindings of one function, or of a
+ * function and its inverse, are pressed in turn so each press changes
+ * something (h then l, inc then dec, tile then monocle); bindings that
+ * cause nothing to time are skipped.  Prints one JSON record per binding
+ * with p50/p99/max.
+ *
+ * Usage: swm-latency [-n iterations]    (make latency runs it on Xvfb)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <X11/extensions/XTest.h>
+#include "swm.h"
+#include "config.h"
+
+#define LATENCY_WINDOWS     6
+#define LATENCY_TIMEOUT_MS  1000
+/* Spawned programs take far longer; a few samples say enough */
+#define SPAWN_ITERATIONS    20
+#define SPAWN_TIMEOUT_MS    5000
+/* Events a press causes after the first must not count for the next */
+#define QUIET_MS            5
+
+typedef struct {
+    const KeyBinding *key;
+    const char *name;
+    int group;                  /* pressed in turn with the same group */
+    int event;                  /* what the binding is timed to */
+    int iterations;
+    int timeout_ms;
+    double *samples;            /* milliseconds */
+    int count;
+    int timeouts;
+} Measure;
+
+static Display *xd;
+static Window xroot;
+static XModifierKeymap *modmap; /* fetched once, outside the timed region */
+static Window windows[LATENCY_WINDOWS];
+
+static bool is_own(Window w) {
+    for (int i = 0; i < LATENCY_WINDOWS; i++) {
+        if (windows[i] == w) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Waits for an event of the given type, or any event when type is 0 */
+static bool wait_event(int type, int timeout_ms, XEvent *ev) {
+    long long deadline = now_ns() + timeout_ms * 1000000LL;
+    struct pollfd pfd = { ConnectionNumber(xd), POLLIN, 0 };
+
+    for (;;) {
+        while (XPending(xd)) {
+            XNextEvent(xd, ev);
+            if (!type || ev->type == type) {
+                return true;
+            }
+        }
+        long long left = deadline - now_ns();
+        if (left <= 0) {
+            return false;
+        }
+        poll(&pfd, 1, (int)((left + 999999) / 1000000));
+    }
+}
+
+static void settle(void) {
+    XEvent ev;
+
+    XSync(xd, False);
+    while (wait_event(0, QUIET_MS, &ev)) {
+    }
+}
+
+/* The first keycode the server maps to each modifier bit */
+static KeyCode modifier_key(XModifierKeymap *map, unsigned int mask) {
+    for (int bit = 0; bit < 8; bit++) {
+        if (mask == (1u << bit)) {
+            for (int k = 0; k < map->max_keypermod; k++) {
+                if (map->modifiermap[bit * map->max_keypermod + k]) {
+                    return map->modifiermap[bit * map->max_keypermod + k];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void press(unsigned int mod, KeySym sym) {
+    KeyCode mods[8], code = XKeysymToKeycode(xd, sym);
+    int n = 0;
+
+    for (int bit = 0; bit < 8; bit++) {
+        if (mod & (1u << bit) && (mods[n] = modifier_key(modmap, 1u << bit))) {
+            XTestFakeKeyEvent(xd, mods[n++], True, CurrentTime);
+        }
+    }
+    XTestFakeKeyEvent(xd, code, True, CurrentTime);
+    XTestFakeKeyEvent(xd, code, False, CurrentTime);
+    while (n--) {
+        XTestFakeKeyEvent(xd, mods[n], False, CurrentTime);
+    }
+    XFlush(xd);
+}
+
+/* Spawned windows and the overview or launcher are removed again so the
+ * next press starts from the same state */
+static void undo(Measure *m, XEvent *ev) {
+    XEvent unmap;
+
+    if (m->key->func == spawn) {
+        XKillClient(xd, ev->xmap.window);
+        wait_event(UnmapNotify, SPAWN_TIMEOUT_MS, &unmap);
+    } else if (m->key->func == overview || m->key->func == launcher) {
+        press(0, XK_Escape);
+        wait_event(UnmapNotify, LATENCY_TIMEOUT_MS, &unmap);
+    }
+}
+
+static void measure(Measure *m) {
+    XEvent ev;
+
+    settle();
+    long long t0 = now_ns();
+    press(m->key->mod, m->key->keysym);
+    for (;;) {
+        if (!wait_event(m->event, m->timeout_ms, &ev)) {
+            m->timeouts++;
+            return;
+        }
+        /* Our own windows' maps are not what a spawn waits for */
+        if (m->event != MapNotify || !is_own(ev.xmap.window)) {
+            break;
+        }
+    }
+    m->samples[m->count++] = (now_ns() - t0) / 1e6;
+    undo(m, &ev);
+}
+
+/* What each function is timed to, and its round-robin group: inverse
+ * functions share one, or the master count would outgrow the windows
+ * and every later press time out.  kill_client, quit_wm and
+ * toggle_focus_mouse have nothing to time */
+static const struct {
+    void (*func)(const char *arg);
+    const char *name;
+    int group;
+    int event;
+} timed[] = {
+    { focus_next,        "focus_next",        0,  FocusIn },
+    { focus_prev,        "focus_prev",        1,  FocusIn },
+    { focus_mru,         "focus_mru",         2,  FocusIn },
+    { spawn,             "spawn",             3,  MapNotify },
+    { overview,          "overview",          4,  MapNotify },
+    { launcher,          "launcher",          5,  MapNotify },
+    { set_layout,        "set_layout",        6,  ConfigureNotify },
+    { set_master_factor, "set_master_factor", 7,  ConfigureNotify },
+    { inc_num_master,    "inc_num_master",    8,  ConfigureNotify },
+    { dec_num_master,    "dec_num_master",    8,  ConfigureNotify },
+    { toggle_floating,   "toggle_floating",   9,  ConfigureNotify },
+    { toggle_fullscreen, "toggle_fullscreen", 10, ConfigureNotify },
+};
+#define GROUPS 11
+
+static int find_timed(const KeyBinding *k) {
+    for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++) {
+        if (timed[i].func == k->func) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Bindings that change nothing a client can see: the floating layout
+ * leaves every window where it is, and the overview may be disabled */
+static bool causes_nothing(const KeyBinding *k) {
+    if (k->func == overview) {
+        return !OVERVIEW;
+    }
+    if (k->func != set_layout || !k->arg) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+        if (!strcmp(layouts[i].name, k->arg)) {
+            return layouts[i].apply == floating_layout;
+        }
+    }
+    return true;
+}
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void create_windows(void) {
+    XSetWindowAttributes wa;
+    XEvent ev;
+
+    wa.event_mask = FocusChangeMask;
+    for (int i = 0; i < LATENCY_WINDOWS; i++) {
+        windows[i] = XCreateWindow(xd, xroot, 0, 0, 200, 200, 0, CopyFromParent,
+                                   InputOutput, CopyFromParent, CWEventMask, &wa);
+        XStoreName(xd, windows[i], "swm-latency");
+        XMapWindow(xd, windows[i]);
+        wait_event(MapNotify, LATENCY_TIMEOUT_MS, &ev);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 2000, event_base, error_base, major, minor;
+    Measure measures[sizeof(keys) / sizeof(keys[0])];
+    int n = 0;
+    bool first = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: swm-latency [-n iterations]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (!(xd = XOpenDisplay(NULL))) {
+        fprintf(stderr, "swm-latency: cannot open display\n");
+        return EXIT_FAILURE;
+    }
+    if (!XTestQueryExtension(xd, &event_base, &error_base, &major, &minor)) {
+        fprintf(stderr, "swm-latency: the server has no XTest extension\n");
+        return EXIT_FAILURE;
+    }
+    xroot = DefaultRootWindow(xd);
+    modmap = XGetModifierMapping(xd);
+    /* swm holds the redirect; watching the notifies is open to anyone */
+    XSelectInput(xd, xroot, SubstructureNotifyMask);
+    create_windows();
+
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        const KeyBinding *key = &keys[k];
+        Measure *m = &measures[n];
+        int t = find_timed(key);
+
+        /* Restarting swm would end the run */
+        if (t < 0 || causes_nothing(key) ||
+            (key->func == spawn && key->arg && !strcmp(key->arg, "swm"))) {
+            continue;
+        }
+        m->key = key;
+        m->name = timed[t].name;
+        m->group = timed[t].group;
+        m->event = timed[t].event;
+        m->iterations = key->func == spawn && iterations > SPAWN_ITERATIONS ?
+                        SPAWN_ITERATIONS : iterations;
+        m->timeout_ms = key->func == spawn ? SPAWN_TIMEOUT_MS : LATENCY_TIMEOUT_MS;
+        m->samples = malloc(m->iterations * sizeof(double));
+        m->count = m->timeouts = 0;
+        if (!m->samples) {
+            return EXIT_FAILURE;
+        }
+        n++;
+    }
+
+    /* Round-robin over the bindings of each group, wherever they are in
+     * keys[] */
+    for (int g = 0; g < GROUPS; g++) {
+        int iterations = 0;
+        for (int j = 0; j < n; j++) {
+            if (measures[j].group == g && measures[j].iterations > iterations) {
+                iterations = measures[j].iterations;
+            }
+        }
+        for (int it = 0; it < iterations; it++) {
+            for (int j = 0; j < n; j++) {
+                if (measures[j].group == g && it < measures[j].iterations) {
+                    measure(&measures[j]);
+                }
+            }
+        }
+    }
+
+    printf("[\n");
+    for (int i = 0; i < n; i++) {
+        Measure *m = &measures[i];
+        double p50 = 0, p99 = 0, max = 0;
+
+        if (m->count) {
+            qsort(m->samples, m->count, sizeof(double), compare);
+            p50 = m->samples[m->count / 2];
+            p99 = m->samples[(int)(m->count * 0.99)];
+            max = m->samples[m->count - 1];
+        }
+        printf("%s  {\"key\": \"%s%s%s%s\", \"function\": \"%s\", \"argument\": \"%s\", "
+               "\"event\": \"%s\", \"samples\": %d, \"timeouts\": %d, "
+               "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}",
+               first ? "" : ",\n",
+               m->key->mod & ControlMask ? "Control+" : "",
+               m->key->mod & ShiftMask ? "Shift+" : "",
+               m->key->mod & ~(ShiftMask | ControlMask) ? "Mod+" : "",
+               XKeysymToString(m->key->keysym), m->name,
+               m->key->arg ? m->key->arg : "",
+               m->event == FocusIn ? "FocusIn" :
+               m->event == MapNotify ? "MapNotify" : "ConfigureNotify",
+               m->count, m->timeouts, p50, p99, max);
+        first = false;
+        free(m->samples);
+    }
+    printf("\n]\n");
+
+    for (int i = 0; i < LATENCY_WINDOWS; i++) {
+        XDestroyWindow(xd, windows[i]);
+    }
+    XFreeModifiermap(modmap);
+    XCloseDisplay(xd);
+    return EXIT_SUCCESS;
+}
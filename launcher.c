@@ -0,0 +1,504 @@
+/*
+ * Application Launcher
+ *
+ * A one-line prompt at the top of the screen that completes executables
+ * from $PATH.  The list lives in memory: every $PATH directory is read
+ * once on the worker pool at startup and again only when inotify reports
+ * a change in it, so opening the prompt touches no file system at all.
+ * Names starting with the input come first, in order, then names that
+ * contain its characters in sequence, closest together first.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE         /* d_type */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include "swm.h"
+
+#define PATH_DIRS       64
+#define INPUT_MAX       256
+#define MATCHES_MAX     64
+#define PROMPT_PAD      6
+
+typedef struct {
+    char path[INPUT_MAX];
+    int wd;
+    char **names;               /* executables found by the last scan */
+    int num_names;
+    char **next;                /* written by a worker while busy */
+    int num_next;
+    bool busy, again;
+} PathDir;
+
+typedef struct {
+    const char *name;
+    int score;                  /* fuzzy matches: span of the match */
+} Match;
+
+static PathDir dirs[PATH_DIRS];
+static int num_dirs;
+static int inotify_fd = -1;
+
+/* Sorted, without duplicates; names point into the directories' lists */
+static const char **names;
+static int num_names, names_capacity;
+
+static bool enabled;
+static bool active;             /* prompt on screen */
+static Window win;
+static Pixmap pixmap;
+static GC gc;
+static XFontSet fontset;
+static int win_h, ascent;
+static char input[INPUT_MAX];
+static Match matches[MATCHES_MAX];
+static int num_matches, selected;
+
+/* Runs on a worker */
+static void scan_work(void *arg) {
+    PathDir *d = arg;
+    char file[2 * INPUT_MAX];
+    struct dirent *de;
+    DIR *dp;
+    int capacity = 0;
+
+    d->next = NULL;
+    d->num_next = 0;
+    if (!(dp = opendir(d->path))) {
+        return;
+    }
+    while ((de = readdir(dp))) {
+        if (de->d_name[0] == '.' || de->d_type == DT_DIR) {
+            continue;
+        }
+        snprintf(file, sizeof(file), "%s/%s", d->path, de->d_name);
+        if (access(file, X_OK) != 0) {
+            continue;
+        }
+        if (d->num_next == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            d->next = realloc(d->next, capacity * sizeof(char *));
+        }
+        d->next[d->num_next++] = strdup(de->d_name);
+    }
+    closedir(dp);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* Merge every directory's list; only after a directory changed */
+static void rebuild_index(void) {
+    int n = 0;
+
+    for (int i = 0; i < num_dirs; i++) {
+        n += dirs[i].num_names;
+    }
+    if (n > names_capacity) {
+        names_capacity = n * 2;
+        names = realloc(names, names_capacity * sizeof(char *));
+    }
+    n = 0;
+    for (int i = 0; i < num_dirs; i++) {
+        for (int j = 0; j < dirs[i].num_names; j++) {
+            names[n++] = dirs[i].names[j];
+        }
+    }
+    qsort(names, n, sizeof(char *), compare_names);
+    /* Matches point into lists the caller is about to free */
+    memset(matches, 0, sizeof(matches));
+    num_matches = selected = 0;
+    num_names = 0;
+    for (int i = 0; i < n; i++) {
+        if (!num_names || strcmp(names[num_names - 1], names[i]) != 0) {
+            names[num_names++] = names[i];
+        }
+    }
+}
+
+static void rescan(PathDir *d);
+static void find_matches(void);
+static void draw(void);
+
+static void scan_done(void *arg) {
+    PathDir *d = arg;
+
+    if (job_cancelled()) {
+        for (int i = 0; i < d->num_next; i++) {
+            free(d->next[i]);
+        }
+        free(d->next);
+        d->next = NULL;
+        d->num_next = 0;
+        d->busy = d->again = false;
+        return;
+    }
+    /* The index points into the old list until it is rebuilt */
+    char **old = d->names;
+    int num_old = d->num_names;
+    d->names = d->next;
+    d->num_names = d->num_next;
+    d->next = NULL;
+    d->num_next = 0;
+    d->busy = false;
+    rebuild_index();
+    for (int i = 0; i < num_old; i++) {
+        free(old[i]);
+    }
+    free(old);
+    stats.path_rescans++;
+    if (active) {
+        /* Matches may point into the freed list */
+        find_matches();
+        draw();
+    }
+    if (d->again) {
+        d->again = false;
+        rescan(d);
+    }
+}
+
+/* A change while a scan runs is picked up by one more scan after it */
+static void rescan(PathDir *d) {
+    if (d->busy) {
+        d->again = true;
+        return;
+    }
+    d->busy = true;
+    queue_job(scan_work, scan_done, d);
+}
+
+static void on_inotify(int fd, short revents) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    (void)revents;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            for (int i = 0; i < num_dirs; i++) {
+                if (dirs[i].wd == ev->wd) {
+                    rescan(&dirs[i]);
+                }
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+static void watch_path(void) {
+    const char *env = getenv("PATH");
+    char path[4096], *dir, *save;
+
+    snprintf(path, sizeof(path), "%s", env ? env : "/usr/local/bin:/usr/bin:/bin");
+    if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0) {
+        watch_fd(inotify_fd, POLLIN, on_inotify);
+    }
+    for (dir = strtok_r(path, ":", &save); dir && num_dirs < PATH_DIRS;
+         dir = strtok_r(NULL, ":", &save)) {
+        bool seen = false;
+        for (int i = 0; i < num_dirs; i++) {
+            seen |= !strcmp(dirs[i].path, dir);
+        }
+        if (seen || !*dir) {
+            continue;
+        }
+        PathDir *d = &dirs[num_dirs++];
+        snprintf(d->path, sizeof(d->path), "%s", dir);
+        d->wd = inotify_fd < 0 ? -1 :
+            inotify_add_watch(inotify_fd, dir, IN_CREATE | IN_DELETE | IN_ATTRIB |
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                              IN_MOVE_SELF);
+        rescan(d);
+    }
+}
+
+/* Subsequence match; the score is how far apart the characters are */
+static bool fuzzy(const char *name, const char *pattern, int *score) {
+    int first = -1, i = 0;
+
+    for (const char *p = pattern; *p; p++) {
+        while (name[i] && tolower((unsigned char)name[i]) != tolower((unsigned char)*p)) {
+            i++;
+        }
+        if (!name[i]) {
+            return false;
+        }
+        if (first < 0) {
+            first = i;
+        }
+        i++;
+    }
+    *score = i - first;
+    return true;
+}
+
+static int compare_matches(const void *a, const void *b) {
+    const Match *x = a, *y = b;
+
+    if (x->score != y->score) {
+        return x->score - y->score;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static void find_matches(void) {
+    size_t n = strlen(input);
+    int lo = 0, hi = num_names, first, worst = 0;
+    char word[INPUT_MAX];
+
+    num_matches = 0;
+    selected = 0;
+    /* Complete the command, not its arguments */
+    snprintf(word, sizeof(word), "%s", input);
+    word[strcspn(word, " ")] = '\0';
+    if (!word[0] || strlen(word) != n) {
+        return;
+    }
+
+    /* Prefix matches are one contiguous run of the sorted index */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strncmp(names[mid], word, n) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    first = lo;
+    for (int i = first; i < num_names && num_matches < MATCHES_MAX &&
+         !strncmp(names[i], word, n); i++) {
+        matches[num_matches++] = (Match){ names[i], 0 };
+    }
+
+    /* Then the best fuzzy matches, keeping only what fits */
+    int prefix = num_matches;
+    for (int i = 0; i < num_names; i++) {
+        int score;
+        if (!strncmp(names[i], word, n) || !fuzzy(names[i], word, &score)) {
+            continue;
+        }
+        if (num_matches < MATCHES_MAX) {
+            matches[num_matches++] = (Match){ names[i], score };
+            if (matches[worst].score < score || worst < prefix) {
+                worst = num_matches - 1;
+            }
+        } else if (worst >= prefix && score < matches[worst].score) {
+            matches[worst] = (Match){ names[i], score };
+            for (int j = prefix; j < num_matches; j++) {
+                if (matches[j].score > matches[worst].score) {
+                    worst = j;
+                }
+            }
+        }
+    }
+    qsort(matches + prefix, num_matches - prefix, sizeof(Match), compare_matches);
+}
+
+static int text_width(const char *text) {
+    XRectangle ink, logical;
+
+    Xutf8TextExtents(fontset, text, strlen(text), &ink, &logical);
+    return logical.width;
+}
+
+static void draw_text(int x, const char *text, bool highlight) {
+    int w = text_width(text) + 2 * PROMPT_PAD;
+
+    XSetForeground(dpy, gc, highlight ? config.border_focus : config.bar_bg);
+    XFillRectangle(dpy, pixmap, gc, x, 0, w, win_h);
+    XSetForeground(dpy, gc, highlight ? config.bar_bg : config.bar_fg);
+    Xutf8DrawString(dpy, pixmap, fontset, gc, x + PROMPT_PAD,
+                    (win_h + ascent) / 2 - 1, text, strlen(text));
+}
+
+static void draw(void) {
+    char prompt[INPUT_MAX + 2];
+    int x, start = 0;
+
+    XSetForeground(dpy, gc, config.bar_bg);
+    XFillRectangle(dpy, pixmap, gc, 0, 0, screen_width, win_h);
+    snprintf(prompt, sizeof(prompt), "%s_", input);
+    draw_text(0, prompt, false);
+    x = screen_width / 4;
+
+    /* Scroll so the selection stays visible */
+    for (int w = 0, i = selected; num_matches > 0 && i >= 0; i--) {
+        w += text_width(matches[i].name) + 2 * PROMPT_PAD;
+        if (w > screen_width - x) {
+            start = i + 1;
+            break;
+        }
+    }
+    for (int i = start; i < num_matches && x < screen_width; i++) {
+        draw_text(x, matches[i].name, i == selected);
+        x += text_width(matches[i].name) + 2 * PROMPT_PAD;
+    }
+    XCopyArea(dpy, pixmap, win, gc, 0, 0, screen_width, win_h, 0, 0);
+}
+
+static void close_launcher(void) {
+    if (!active) {
+        return;
+    }
+    active = false;
+    XUngrabKeyboard(dpy, CurrentTime);
+    XUnmapWindow(dpy, win);
+}
+
+void launcher(const char *arg) {
+    (void)arg;
+
+    if (!enabled) {
+        return;
+    }
+    if (active) {
+        close_launcher();
+        return;
+    }
+    trace_begin("open_launcher", "launcher");
+    input[0] = '\0';
+    num_matches = selected = 0;
+    active = true;
+    XMapRaised(dpy, win);
+    XGrabKeyboard(dpy, win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+    draw();
+    trace_end();
+}
+
+static void on_key(XKeyEvent *ev) {
+    char text[32];
+    KeySym keysym;
+    int len = XLookupString(ev, text, sizeof(text) - 1, &keysym, NULL);
+    size_t n = strlen(input);
+
+    switch (keysym) {
+    case XK_Escape:
+        close_launcher();
+        return;
+    case XK_Return:
+    case XK_KP_Enter:
+        /* A command with arguments runs as typed */
+        spawn(num_matches && !strchr(input, ' ') ? matches[selected].name : input);
+        close_launcher();
+        return;
+    case XK_Tab:
+        if (num_matches) {
+            snprintf(input, sizeof(input), "%s", matches[selected].name);
+            find_matches();
+        }
+        break;
+    case XK_Right:
+        if (selected + 1 < num_matches) {
+            selected++;
+        }
+        break;
+    case XK_Left:
+        if (selected > 0) {
+            selected--;
+        }
+        break;
+    case XK_BackSpace:
+        if (n) {
+            input[n - 1] = '\0';
+            find_matches();
+        }
+        break;
+    default:
+        if (len <= 0 || iscntrl((unsigned char)text[0]) || n + len >= sizeof(input)) {
+            return;
+        }
+        memcpy(input + n, text, len);
+        input[n + len] = '\0';
+        find_matches();
+        break;
+    }
+    draw();
+}
+
+/* Input and exposure of the prompt; true when consumed */
+bool launcher_event(XEvent *ev) {
+    if (!active || ev->xany.window != win) {
+        return false;
+    }
+    if (ev->type == KeyPress) {
+        on_key(&ev->xkey);
+    } else if (ev->type == Expose && ev->xexpose.count == 0) {
+        XCopyArea(dpy, pixmap, win, gc, 0, 0, screen_width, win_h, 0, 0);
+    }
+    return true;
+}
+
+void create_launcher(void) {
+    XSetWindowAttributes wa;
+    XFontSetExtents *extents;
+    char **missing, *def;
+    int nmissing;
+
+    if (!dpy) {
+        return;
+    }
+    if (!(fontset = XCreateFontSet(dpy, config.font, &missing, &nmissing, &def)) &&
+        !(fontset = XCreateFontSet(dpy, "fixed", &missing, &nmissing, &def))) {
+        fprintf(stderr, "swm: no usable font, launcher disabled\n");
+        return;
+    }
+    if (missing) {
+        XFreeStringList(missing);
+    }
+    extents = XExtentsOfFontSet(fontset);
+    ascent = -extents->max_logical_extent.y;
+    win_h = extents->max_logical_extent.height + 2 * PROMPT_PAD;
+
+    /* Created up front: opening is a map and a grab */
+    wa.override_redirect = True;
+    wa.background_pixel = config.bar_bg;
+    wa.event_mask = ExposureMask | KeyPressMask;
+    win = XCreateWindow(dpy, root, 0, 0, screen_width, win_h, 0,
+                        DefaultDepth(dpy, screen), CopyFromParent,
+                        DefaultVisual(dpy, screen),
+                        CWOverrideRedirect | CWBackPixel | CWEventMask, &wa);
+    pixmap = XCreatePixmap(dpy, root, screen_width, win_h, DefaultDepth(dpy, screen));
+    gc = XCreateGC(dpy, root, 0, NULL);
+
+    watch_path();
+    enabled = true;
+}
+
+/* After stop_workers(), which hands back the lists of dropped scans */
+void destroy_launcher(void) {
+    if (!enabled) {
+        return;
+    }
+    close_launcher();
+    if (inotify_fd >= 0) {
+        unwatch_fd(inotify_fd);
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    for (int i = 0; i < num_dirs; i++) {
+        for (int j = 0; j < dirs[i].num_names; j++) {
+            free(dirs[i].names[j]);
+        }
+        free(dirs[i].names);
+    }
+    num_dirs = 0;
+    free(names);
+    names = NULL;
+    num_names = names_capacity = 0;
+    XFreePixmap(dpy, pixmap);
+    XFreeGC(dpy, gc);
+    XDestroyWindow(dpy, win);
+    XFreeFontSet(dpy, fontset);
+    enabled = false;
+}
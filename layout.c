@@ -12,7 +12,7 @@ static int count_clients(Monitor *m) {
     int n = 0;
     Client *c;
     for (c = m->clients; c; c = c->next) {
-        if (!c->is_floating && !c->is_fullscreen) {
+        if (!c->is_floating && !c->is_fullscreen && !c->is_iconic) {
             n++;
         }
     }
@@ -35,7 +35,7 @@ void tile_layout(Monitor *m) {
     int i = 0;
     Client *c;
     for (c = m->clients; c; c = c->next) {
-        if (c->is_floating || c->is_fullscreen) {
+        if (c->is_floating || c->is_fullscreen || c->is_iconic) {
             continue;
         }
         
@@ -44,16 +44,16 @@ void tile_layout(Monitor *m) {
             resize_client(c, 
                 m->x,
                 m->y + i * master_height,
-                master_width - 2 * config.border_width,
-                master_height - 2 * config.border_width);
+                master_width - 2 * c->bw,
+                master_height - 2 * c->bw);
         } else {
             /* Stack area */
             int stack_idx = i - m->num_master;
             resize_client(c,
                 m->x + master_width,
                 m->y + stack_idx * stack_height,
-                stack_width - 2 * config.border_width,
-                stack_height - 2 * config.border_width);
+                stack_width - 2 * c->bw,
+                stack_height - 2 * c->bw);
         }
         show_client(c);
         i++;
@@ -65,7 +65,7 @@ void monocle_layout(Monitor *m) {
     Client *c;
     
     for (c = m->clients; c; c = c->next) {
-        if (c->is_floating || c->is_fullscreen) {
+        if (c->is_floating || c->is_fullscreen || c->is_iconic) {
             continue;
         }
         
@@ -73,8 +73,8 @@ void monocle_layout(Monitor *m) {
             resize_client(c,
                 m->x,
                 m->y,
-                m->w - 2 * config.border_width,
-                m->h - 2 * config.border_width);
+                m->w - 2 * c->bw,
+                m->h - 2 * c->bw);
             show_client(c);
         } else {
             hide_client(c);
@@ -87,7 +87,7 @@ void floating_layout(Monitor *m) {
     Client *c;
     
     for (c = m->clients; c; c = c->next) {
-        if (c->is_fullscreen) {
+        if (c->is_fullscreen || c->is_iconic) {
             continue;
         }
         show_client(c);
@@ -110,7 +110,7 @@ void grid_layout(Monitor *m) {
     int i = 0;
     Client *c;
     for (c = m->clients; c; c = c->next) {
-        if (c->is_floating || c->is_fullscreen) {
+        if (c->is_floating || c->is_fullscreen || c->is_iconic) {
             continue;
         }
         
@@ -120,8 +120,8 @@ void grid_layout(Monitor *m) {
         resize_client(c,
             m->x + col * cell_w,
             m->y + row * cell_h,
-            cell_w - 2 * config.border_width,
-            cell_h - 2 * config.border_width);
+            cell_w - 2 * c->bw,
+            cell_h - 2 * c->bw);
         show_client(c);
         i++;
     }
@@ -132,19 +132,25 @@ void apply_layout(void) {
         return;
     }
     
-    /* Handle fullscreen clients */
+    trace_begin("apply_layout", "layout");
+    
+    /* Fullscreen clients already covering the screen are left alone */
     Client *c;
+    mon->passes++;
     for (c = mon->clients; c; c = c->next) {
-        if (c->is_fullscreen) {
+        if (c->is_fullscreen && (c->x || c->y || c->w != screen_width ||
+                                 c->h != screen_height)) {
             resize_client(c, 0, 0, screen_width, screen_height);
-            XRaiseWindow(dpy, c->win);
         }
     }
     
     /* Apply layout to non-fullscreen clients */
+    trace_begin(mon->layout->name, "layout");
     mon->layout->apply(mon);
+    trace_end();
     
-    XSync(dpy, False);
+    be->sync();
+    trace_end();
 }
 
 void set_layout(const char *arg) {
@@ -154,6 +160,9 @@ void set_layout(const char *arg) {
     
     for (int i = 0; i < config.num_layouts; i++) {
         if (strcmp(config.layouts[i].name, arg) == 0) {
+            if (mon->layout != &config.layouts[i]) {
+                mon->tree_stale = true;
+            }
             mon->layout = &config.layouts[i];
             apply_layout();
             return;
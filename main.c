@@ -0,0 +1,53 @@
+/*
+ * Simple Window Manager (SWM)
+ * Entry point
+ */
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swm.h"
+
+int main(int argc, char *argv[]) {
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *trace_path = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (!strcmp(argv[i], "-m")) {
+            be = &mock_backend;
+        } else {
+            die("usage: swm [-r trace] [-p trace] [-m] [-t trace.json]");
+        }
+    }
+    
+    /* The mock has no event source of its own, it can only replay */
+    if (be == &mock_backend && !replay_path) {
+        die("-m needs a trace to replay (-p)");
+    }
+    
+    setlocale(LC_CTYPE, "");
+    /* Before setup starts any thread, so SIGUSR2 stays blocked in all */
+    trace_init(trace_path);
+    
+    setup();
+    if (replay_path) {
+        replay(replay_path);
+    } else {
+        if (record_path) {
+            record_start(record_path);
+        }
+        /* Scan for existing windows */
+        scan();
+        run();
+        record_stop();
+    }
+    cleanup();
+    return EXIT_SUCCESS;
+}
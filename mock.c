@@ -0,0 +1,582 @@
+/*
+ * In-Memory Mock Display Backend
+ *
+ * Simulates just enough of an X server for swm's own logic to run without
+ * one: windows with geometry, border, map state and properties, atoms and
+ * selections.  Every request is counted instead of being sent anywhere, so
+ * layout, focus and tray code can be replayed and benchmarked headless.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include "swm.h"
+
+#define MOCK_ROOT       1
+#define MOCK_WIDTH      1920
+#define MOCK_HEIGHT     1080
+#define MOCK_FIRST_ID   0x200000
+#define MOCK_FIRST_ATOM 1000
+#define MOCK_MAX_ATOMS  256
+
+/* Default size of windows the mock first hears about from a request */
+#define MOCK_DEFAULT_W  640
+#define MOCK_DEFAULT_H  480
+
+enum {
+    OpGetAttributes, OpSelectInput, OpMoveResize, OpConfigure, OpMap,
+    OpUnmap, OpRaise, OpRestack, OpBorderWidth, OpBorder, OpFocus, OpGetProperty,
+    OpChangeProperty, OpSendEvent, OpInternAtom, OpCreateWindow,
+    OpDestroyWindow, OpReparent, OpGetSelection, OpSetSelection,
+    OpQueryTree, OpGrabKey, OpUngrabKeys, OpGrabKeyboard, OpUngrabKeyboard,
+    OpKill, OpClientPid, OpClientResources, OpAllocColor, OpSync,
+    OpLast
+};
+
+static const char *op_names[OpLast] = {
+    "GetWindowAttributes", "SelectInput", "MoveResizeWindow",
+    "ConfigureWindow", "MapWindow", "UnmapWindow", "RaiseWindow", "RestackWindows",
+    "SetWindowBorderWidth", "SetWindowBorder", "SetInputFocus",
+    "GetProperty", "ChangeProperty", "SendEvent", "InternAtom",
+    "CreateWindow", "DestroyWindow", "ReparentWindow",
+    "GetSelectionOwner", "SetSelectionOwner", "QueryTree", "GrabKey",
+    "UngrabKey", "GrabKeyboard", "UngrabKeyboard", "KillClient",
+    "XResQueryClientIds", "XResClientResources", "AllocNamedColor", "Sync",
+};
+
+typedef struct MockProp {
+    Atom name, type;
+    int format;
+    unsigned long n;
+    unsigned char *data;
+    struct MockProp *next;
+} MockProp;
+
+typedef struct {
+    Window id;
+    Window parent;
+    int x, y, w, h;
+    unsigned int bw;
+    unsigned long border;
+    long mask;
+    bool mapped;
+    bool destroyed;
+    bool override_redirect;
+    MockProp *props;
+} MockWindow;
+
+static MockWindow *windows;
+static unsigned long num_windows, cap_windows;
+static Window next_id = MOCK_FIRST_ID;
+static char *atoms[MOCK_MAX_ATOMS];
+static int num_atoms;
+static Atom selection_atom;
+static Window selection_owner;
+static Window focus;
+static KeySym keymap[256];
+static unsigned long ops[OpLast];
+static unsigned long total_ops;
+
+static void count(int op) {
+    ops[op]++;
+    total_ops++;
+}
+
+static unsigned long slot(Window id, unsigned long cap) {
+    return (id * 2654435761UL) & (cap - 1);
+}
+
+static void grow(void) {
+    MockWindow *old = windows;
+    unsigned long old_cap = cap_windows;
+
+    cap_windows = cap_windows ? cap_windows * 2 : 1024;
+    windows = calloc(cap_windows, sizeof(MockWindow));
+    for (unsigned long i = 0; i < old_cap; i++) {
+        if (old[i].id) {
+            unsigned long s = slot(old[i].id, cap_windows);
+            while (windows[s].id) {
+                s = (s + 1) & (cap_windows - 1);
+            }
+            windows[s] = old[i];
+        }
+    }
+    free(old);
+}
+
+/* Find a window, optionally simulating one the mock has not seen yet */
+static MockWindow *lookup(Window id, bool create) {
+    unsigned long s;
+
+    if (!id) {
+        return NULL;
+    }
+    if (cap_windows) {
+        for (s = slot(id, cap_windows); windows[s].id; s = (s + 1) & (cap_windows - 1)) {
+            if (windows[s].id == id) {
+                return windows[s].destroyed ? NULL : &windows[s];
+            }
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if ((num_windows + 1) * 2 > cap_windows) {
+        grow();
+    }
+    for (s = slot(id, cap_windows); windows[s].id; s = (s + 1) & (cap_windows - 1));
+    num_windows++;
+    memset(&windows[s], 0, sizeof(MockWindow));
+    windows[s].id = id;
+    windows[s].parent = MOCK_ROOT;
+    windows[s].w = MOCK_DEFAULT_W;
+    windows[s].h = MOCK_DEFAULT_H;
+    return &windows[s];
+}
+
+Window mock_add_window(int x, int y, int w, int h, bool override_redirect) {
+    MockWindow *mw = lookup(next_id++, true);
+
+    mw->x = x;
+    mw->y = y;
+    mw->w = w;
+    mw->h = h;
+    mw->override_redirect = override_redirect;
+    return mw->id;
+}
+
+static Bool mock_open(void) {
+    dpy = NULL;
+    screen = 0;
+    root = MOCK_ROOT;
+    screen_width = MOCK_WIDTH;
+    screen_height = MOCK_HEIGHT;
+    lookup(MOCK_ROOT, true)->mapped = true;
+    return True;
+}
+
+static void mock_close(void) {
+    for (unsigned long i = 0; i < cap_windows; i++) {
+        MockProp *p, *next;
+        for (p = windows[i].props; p; p = next) {
+            next = p->next;
+            free(p->data);
+            free(p);
+        }
+    }
+    free(windows);
+    windows = NULL;
+    num_windows = cap_windows = 0;
+    for (int i = 0; i < num_atoms; i++) {
+        free(atoms[i]);
+    }
+    num_atoms = 0;
+}
+
+static Bool mock_get_attributes(Window win, XWindowAttributes *wa) {
+    MockWindow *mw;
+
+    count(OpGetAttributes);
+    if (!(mw = lookup(win, true))) {
+        return False;
+    }
+    memset(wa, 0, sizeof(*wa));
+    wa->x = mw->x;
+    wa->y = mw->y;
+    wa->width = mw->w;
+    wa->height = mw->h;
+    wa->border_width = mw->bw;
+    wa->override_redirect = mw->override_redirect;
+    wa->map_state = mw->mapped ? IsViewable : IsUnmapped;
+    wa->your_event_mask = mw->mask;
+    wa->root = MOCK_ROOT;
+    return True;
+}
+
+static void mock_select_input(Window win, long mask) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpSelectInput);
+    if (mw) {
+        mw->mask = mask;
+    }
+}
+
+static void mock_move_resize(Window win, int x, int y, int width, int height) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpMoveResize);
+    if (mw) {
+        mw->x = x;
+        mw->y = y;
+        mw->w = width;
+        mw->h = height;
+    }
+}
+
+static void mock_configure(Window win, unsigned int mask, XWindowChanges *wc) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpConfigure);
+    if (!mw) {
+        return;
+    }
+    if (mask & CWX) {
+        mw->x = wc->x;
+    }
+    if (mask & CWY) {
+        mw->y = wc->y;
+    }
+    if (mask & CWWidth) {
+        mw->w = wc->width;
+    }
+    if (mask & CWHeight) {
+        mw->h = wc->height;
+    }
+    if (mask & CWBorderWidth) {
+        mw->bw = wc->border_width;
+    }
+}
+
+static void mock_map(Window win) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpMap);
+    if (mw) {
+        mw->mapped = true;
+    }
+}
+
+static void mock_unmap(Window win) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpUnmap);
+    if (mw) {
+        mw->mapped = false;
+    }
+}
+
+static void mock_raise(Window win) {
+    (void)win;
+    count(OpRaise);
+}
+
+static void mock_restack(Window *wins, int n) {
+    (void)wins;
+    (void)n;
+    count(OpRestack);
+}
+
+static void mock_set_border_width(Window win, unsigned int width) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpBorderWidth);
+    if (mw) {
+        mw->bw = width;
+    }
+}
+
+static void mock_set_border(Window win, unsigned long pixel) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpBorder);
+    if (mw) {
+        mw->border = pixel;
+    }
+}
+
+static void mock_set_focus(Window win) {
+    count(OpFocus);
+    focus = win;
+}
+
+/* No round trips to save */
+static void mock_prefetch_properties(Window win, const PropertyRequest *req, int n) {
+    (void)win;
+    (void)req;
+    (void)n;
+}
+
+static size_t prop_bytes(int format, unsigned long n) {
+    return n * (format == 32 ? sizeof(long) : (size_t)format / 8);
+}
+
+static int mock_get_property(Window win, Atom prop, Atom type, long length,
+                             Atom *actual_type, int *format,
+                             unsigned long *nitems, unsigned char **data) {
+    MockWindow *mw = lookup(win, false);
+    MockProp *p;
+
+    count(OpGetProperty);
+    *actual_type = None;
+    *format = 0;
+    *nitems = 0;
+    *data = NULL;
+    if (!mw) {
+        return BadWindow;
+    }
+    for (p = mw->props; p && p->name != prop; p = p->next);
+    if (!p || (type != AnyPropertyType && type != p->type)) {
+        return Success;
+    }
+
+    unsigned long n = p->n < (unsigned long)length * (32 / p->format) ? p->n :
+                      (unsigned long)length * (32 / p->format);
+    *actual_type = p->type;
+    *format = p->format;
+    *nitems = n;
+    *data = malloc(prop_bytes(p->format, n) + 1);
+    memcpy(*data, p->data, prop_bytes(p->format, n));
+    (*data)[prop_bytes(p->format, n)] = '\0';
+    return Success;
+}
+
+static void mock_change_property(Window win, Atom prop, Atom type, int format,
+                                 int mode, const unsigned char *data, int n) {
+    MockWindow *mw = lookup(win, true);
+    MockProp *p;
+
+    count(OpChangeProperty);
+    if (!mw) {
+        return;
+    }
+    for (p = mw->props; p && p->name != prop; p = p->next);
+    if (!p) {
+        p = calloc(1, sizeof(MockProp));
+        p->name = prop;
+        p->next = mw->props;
+        mw->props = p;
+        mode = PropModeReplace;
+    }
+    if (mode == PropModeReplace) {
+        free(p->data);
+        p->data = malloc(prop_bytes(format, n) + 1);
+        memcpy(p->data, data, prop_bytes(format, n));
+        p->n = n;
+    } else {
+        size_t old = prop_bytes(format, p->n), add = prop_bytes(format, n);
+        unsigned char *buf = malloc(old + add + 1);
+        if (mode == PropModeAppend) {
+            memcpy(buf, p->data, old);
+            memcpy(buf + old, data, add);
+        } else {
+            memcpy(buf, data, add);
+            memcpy(buf + add, p->data, old);
+        }
+        free(p->data);
+        p->data = buf;
+        p->n += n;
+    }
+    p->type = type;
+    p->format = format;
+}
+
+static void mock_send_event(Window win, long mask, XEvent *ev) {
+    (void)win;
+    (void)mask;
+    (void)ev;
+    count(OpSendEvent);
+}
+
+static Atom mock_intern_atom(const char *name) {
+    int i;
+
+    count(OpInternAtom);
+    for (i = 0; i < num_atoms; i++) {
+        if (!strcmp(atoms[i], name)) {
+            return MOCK_FIRST_ATOM + i;
+        }
+    }
+    if (num_atoms == MOCK_MAX_ATOMS) {
+        die("mock: out of atoms");
+    }
+    atoms[num_atoms] = strdup(name);
+    return MOCK_FIRST_ATOM + num_atoms++;
+}
+
+static Window mock_create_window(Window parent, int x, int y, int width,
+                                 int height, unsigned long mask,
+                                 XSetWindowAttributes *wa) {
+    MockWindow *mw;
+
+    count(OpCreateWindow);
+    mw = lookup(next_id++, true);
+    mw->parent = parent;
+    mw->x = x;
+    mw->y = y;
+    mw->w = width;
+    mw->h = height;
+    if (mask & CWOverrideRedirect) {
+        mw->override_redirect = wa->override_redirect;
+    }
+    if (mask & CWEventMask) {
+        mw->mask = wa->event_mask;
+    }
+    return mw->id;
+}
+
+static void mock_destroy_window(Window win) {
+    MockWindow *mw = lookup(win, false);
+
+    count(OpDestroyWindow);
+    if (mw) {
+        mw->destroyed = true;
+        mw->mapped = false;
+    }
+}
+
+static void mock_reparent(Window win, Window parent, int x, int y) {
+    MockWindow *mw = lookup(win, true);
+
+    count(OpReparent);
+    if (mw) {
+        mw->parent = parent;
+        mw->x = x;
+        mw->y = y;
+    }
+}
+
+static Window mock_get_selection_owner(Atom selection) {
+    count(OpGetSelection);
+    return selection == selection_atom ? selection_owner : None;
+}
+
+static void mock_set_selection_owner(Atom selection, Window owner) {
+    count(OpSetSelection);
+    selection_atom = selection;
+    selection_owner = owner;
+}
+
+static Bool mock_query_tree(Window win, Window **children, unsigned int *n) {
+    unsigned int k = 0;
+
+    count(OpQueryTree);
+    *children = malloc((num_windows + 1) * sizeof(Window));
+    for (unsigned long i = 0; i < cap_windows; i++) {
+        if (windows[i].id && !windows[i].destroyed &&
+            windows[i].id != win && windows[i].parent == win) {
+            (*children)[k++] = windows[i].id;
+        }
+    }
+    *n = k;
+    return True;
+}
+
+static void mock_grab_key(KeySym keysym, unsigned int mod) {
+    (void)keysym;
+    (void)mod;
+    count(OpGrabKey);
+}
+
+static void mock_ungrab_keys(void) {
+    count(OpUngrabKeys);
+}
+
+/* Replayed traces carry the modifier release that ends the grab */
+static Bool mock_grab_keyboard(void) {
+    count(OpGrabKeyboard);
+    return True;
+}
+
+static void mock_ungrab_keyboard(void) {
+    count(OpUngrabKeyboard);
+}
+
+/* Replay teaches the mock which keysym each recorded keycode produced */
+void mock_set_keysym(KeyCode code, KeySym keysym) {
+    keymap[code] = keysym;
+}
+
+static KeySym mock_lookup_keysym(XKeyEvent *ev) {
+    return keymap[ev->keycode & 0xff];
+}
+
+static void mock_kill(Window win) {
+    count(OpKill);
+    mock_destroy_window(win);
+}
+
+/* Simulated windows belong to no process */
+static pid_t mock_client_pid(Window win) {
+    (void)win;
+    count(OpClientPid);
+    return 0;
+}
+
+/* No server to ask */
+static Bool mock_client_resources(Window win, unsigned long *num,
+                                  unsigned long *pixmap_bytes) {
+    (void)win;
+    (void)num;
+    (void)pixmap_bytes;
+    count(OpClientResources);
+    return False;
+}
+
+static unsigned long mock_alloc_color(const char *name) {
+    count(OpAllocColor);
+    return name[0] == '#' ? strtoul(name + 1, NULL, 16) : 0;
+}
+
+static void mock_sync(void) {
+    count(OpSync);
+}
+
+static unsigned long mock_requests(void) {
+    return total_ops;
+}
+
+static void mock_report(FILE *fp) {
+    fprintf(fp, "%-22s %10s\n", "request", "count");
+    for (int i = 0; i < OpLast; i++) {
+        if (ops[i]) {
+            fprintf(fp, "%-22s %10lu\n", op_names[i], ops[i]);
+        }
+    }
+    fprintf(fp, "mock: %lu windows simulated, focus 0x%lx\n",
+            num_windows, focus);
+}
+
+const Backend mock_backend = {
+    .name = "mock",
+    .open = mock_open,
+    .close = mock_close,
+    .get_attributes = mock_get_attributes,
+    .select_input = mock_select_input,
+    .move_resize = mock_move_resize,
+    .configure = mock_configure,
+    .map = mock_map,
+    .unmap = mock_unmap,
+    .raise = mock_raise,
+    .restack = mock_restack,
+    .set_border_width = mock_set_border_width,
+    .set_border = mock_set_border,
+    .set_focus = mock_set_focus,
+    .get_property = mock_get_property,
+    .prefetch_properties = mock_prefetch_properties,
+    .change_property = mock_change_property,
+    .send_event = mock_send_event,
+    .intern_atom = mock_intern_atom,
+    .create_window = mock_create_window,
+    .destroy_window = mock_destroy_window,
+    .reparent = mock_reparent,
+    .get_selection_owner = mock_get_selection_owner,
+    .set_selection_owner = mock_set_selection_owner,
+    .query_tree = mock_query_tree,
+    .grab_key = mock_grab_key,
+    .ungrab_keys = mock_ungrab_keys,
+    .grab_keyboard = mock_grab_keyboard,
+    .ungrab_keyboard = mock_ungrab_keyboard,
+    .lookup_keysym = mock_lookup_keysym,
+    .kill = mock_kill,
+    .client_pid = mock_client_pid,
+    .client_resources = mock_client_resources,
+    .alloc_color = mock_alloc_color,
+    .sync = mock_sync,
+    .requests = mock_requests,
+    .report = mock_report,
+};
@@ -0,0 +1,656 @@
+/*
+ * Window Overview
+ *
+ * Shows every client as a downscaled thumbnail in a grid; clicking one,
+ * or typing part of its title and pressing Return, focuses it.  Only with
+ * OVERVIEW set: each managed window is then redirected with XComposite so
+ * its contents stay available, except while it is fullscreen, and each
+ * client keeps a small cached thumbnail scaled down with XRender.
+ * Opening the overview only composes these cached pictures; window
+ * contents are read again only after they changed: on XDamage reports
+ * when built with XDAMAGE=1, otherwise when a window loses focus.
+ * Refreshes are batched on a timer, often while the overview is open and
+ * rarely while it is closed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xrender.h>
+#ifdef XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+#include "swm.h"
+
+#define THUMB_SIZE          256     /* longest side of a cached thumbnail */
+#define CELL_PAD            24
+#define FILTER_MAX          64
+#define REFRESH_OPEN_MS     50
+#define REFRESH_CLOSED_MS   1000
+
+struct Thumbnail {
+    Pixmap pixmap;
+    Picture picture;
+    XRenderPictFormat *format;  /* the window's, for reading its contents */
+    int w, h;
+    bool valid;                 /* holds the window's contents at some point */
+    bool dirty;                 /* contents changed since */
+#ifdef XDAMAGE
+    Damage damage;
+#endif
+};
+
+static bool enabled;
+static bool active;             /* overview on screen */
+static Window win;
+static Pixmap back;
+static Picture back_picture;
+static GC gc;
+static XFontSet fontset;
+static int ascent;
+static int timer_fd = -1;
+static bool timer_armed;
+#ifdef XDAMAGE
+static int damage_event;
+#endif
+
+/* Clients on screen, most recently focused first, and their cells */
+static Client **shown;
+static int num_shown, capacity;
+static int cols, cell_w, cell_h;
+static int selected;
+static char filter[FILTER_MAX];
+
+static XRenderColor bg_color = { 0x1000, 0x1000, 0x1000, 0xffff };
+static XRenderColor sel_color = { 0x0000, 0x8800, 0xcc00, 0xffff };
+
+static void arm_timer(void) {
+    struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+    long ms = active ? REFRESH_OPEN_MS : REFRESH_CLOSED_MS;
+
+    if (timer_armed || timer_fd < 0) {
+        return;
+    }
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    timer_armed = true;
+}
+
+static void mark_dirty(Client *c) {
+    if (c->thumb && !c->thumb->dirty) {
+        c->thumb->dirty = true;
+        arm_timer();
+    }
+}
+
+static Thumbnail *new_thumbnail(Client *c) {
+    XWindowAttributes wa;
+    Thumbnail *t;
+
+    if (!be->get_attributes(c->win, &wa) ||
+        !(t = calloc(1, sizeof(Thumbnail)))) {
+        return NULL;
+    }
+    t->format = XRenderFindVisualFormat(dpy, wa.visual);
+#ifdef XDAMAGE
+    /* One report until the damage is subtracted, i.e. per refresh */
+    t->damage = XDamageCreate(dpy, c->win, XDamageReportNonEmpty);
+#endif
+    t->dirty = true;
+    c->thumb = t;
+    return t;
+}
+
+/* Read the window's contents once and scale them into the cache */
+static void render_thumbnail(Client *c) {
+    Thumbnail *t = c->thumb;
+    XRenderPictureAttributes pa;
+    XTransform xf;
+    Pixmap contents;
+    Picture src;
+    int sw = c->w + 2 * c->bw, sh = c->h + 2 * c->bw;
+    double scale;
+
+    /* Unmapped and unredirected windows have no contents to read; keep
+     * what was cached */
+    if (!t || !t->format || !c->redirected || (c->is_hidden && c->hidden_by == HideUnmap) ||
+        sw <= 0 || sh <= 0) {
+        return;
+    }
+    trace_begin("render_thumbnail", "overview");
+    scale = (double)THUMB_SIZE / (sw > sh ? sw : sh);
+    if (scale > 1) {
+        scale = 1;
+    }
+    int w = sw * scale > 1 ? sw * scale : 1;
+    int h = sh * scale > 1 ? sh * scale : 1;
+    if (w != t->w || h != t->h) {
+        if (t->picture) {
+            XRenderFreePicture(dpy, t->picture);
+            XFreePixmap(dpy, t->pixmap);
+        }
+        t->w = w;
+        t->h = h;
+        t->pixmap = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+        t->picture = XRenderCreatePicture(dpy, t->pixmap,
+            XRenderFindVisualFormat(dpy, DefaultVisual(dpy, screen)), 0, NULL);
+    }
+
+#ifdef XDAMAGE
+    XDamageSubtract(dpy, t->damage, None, None);
+#endif
+    contents = XCompositeNameWindowPixmap(dpy, c->win);
+    pa.subwindow_mode = IncludeInferiors;
+    src = XRenderCreatePicture(dpy, contents, t->format, CPSubwindowMode, &pa);
+    memset(&xf, 0, sizeof(xf));
+    xf.matrix[0][0] = XDoubleToFixed((double)sw / w);
+    xf.matrix[1][1] = XDoubleToFixed((double)sh / h);
+    xf.matrix[2][2] = XDoubleToFixed(1);
+    XRenderSetPictureTransform(dpy, src, &xf);
+    XRenderSetPictureFilter(dpy, src, FilterBilinear, NULL, 0);
+    XRenderComposite(dpy, PictOpSrc, src, None, t->picture, 0, 0, 0, 0, 0, 0, w, h);
+    XRenderFreePicture(dpy, src);
+    XFreePixmap(dpy, contents);
+
+    t->valid = true;
+    t->dirty = false;
+    stats.thumbnails++;
+    trace_end();
+}
+
+static bool matches(Client *c) {
+    size_t n = strlen(filter);
+
+    if (!n) {
+        return true;
+    }
+    for (const char *p = c->name; *p; p++) {
+        if (!strncasecmp(p, filter, n)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void collect(void) {
+    int n = 0;
+
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        n++;
+    }
+    if (n > capacity) {
+        capacity = n * 2;
+        shown = realloc(shown, capacity * sizeof(Client *));
+    }
+    num_shown = 0;
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        if (!c->is_desktop && matches(c)) {
+            shown[num_shown++] = c;
+        }
+    }
+    if (selected >= num_shown) {
+        selected = num_shown ? num_shown - 1 : 0;
+    }
+
+    cols = 1;
+    while (cols * cols < num_shown) {
+        cols++;
+    }
+    int rows = num_shown ? (num_shown + cols - 1) / cols : 1;
+    cell_w = screen_width / cols;
+    cell_h = (screen_height - ascent - 2 * CELL_PAD) / rows;
+}
+
+/* Compose the cached thumbnail into its cell, never bigger than cached */
+static void draw_cell(int i) {
+    Client *c = shown[i];
+    Thumbnail *t = c->thumb;
+    int x = (i % cols) * cell_w, y = ascent + 2 * CELL_PAD + (i / cols) * cell_h;
+    int aw = cell_w - 2 * CELL_PAD, ah = cell_h - 2 * CELL_PAD - ascent;
+    int tw = aw, th = ah;
+
+    XRenderFillRectangle(dpy, PictOpSrc, back_picture, &bg_color, x, y, cell_w, cell_h);
+    if (aw <= 0 || ah <= 0) {
+        return;
+    }
+    double scale = 1;
+    if (t && t->valid) {
+        scale = fmin(1.0, fmin((double)aw / t->w, (double)ah / t->h));
+        tw = t->w * scale;
+        th = t->h * scale;
+    }
+    int tx = x + (cell_w - tw) / 2, ty = y + CELL_PAD + (ah - th) / 2;
+    if (i == selected) {
+        XRenderFillRectangle(dpy, PictOpSrc, back_picture, &sel_color,
+                             tx - 3, ty - 3, tw + 6, th + 6);
+        XRenderFillRectangle(dpy, PictOpSrc, back_picture, &bg_color, tx, ty, tw, th);
+    }
+    if (t && t->valid) {
+        XTransform xf;
+
+        memset(&xf, 0, sizeof(xf));
+        xf.matrix[0][0] = xf.matrix[1][1] = XDoubleToFixed(1 / scale);
+        xf.matrix[2][2] = XDoubleToFixed(1);
+        XRenderSetPictureTransform(dpy, t->picture, &xf);
+        XRenderSetPictureFilter(dpy, t->picture, FilterBilinear, NULL, 0);
+        XRenderComposite(dpy, PictOpSrc, t->picture, None, back_picture,
+                         0, 0, 0, 0, tx, ty, tw, th);
+        xf.matrix[0][0] = xf.matrix[1][1] = XDoubleToFixed(1);
+        XRenderSetPictureTransform(dpy, t->picture, &xf);
+    }
+    if (fontset && c->name[0]) {
+        XRectangle clip = { x + CELL_PAD, y, aw, cell_h };
+        XSetClipRectangles(dpy, gc, 0, 0, &clip, 1, Unsorted);
+        XSetForeground(dpy, gc, i == selected ? config.border_focus : config.bar_fg);
+        Xutf8DrawString(dpy, back, fontset, gc, x + CELL_PAD,
+                        y + cell_h - CELL_PAD / 2, c->name, strlen(c->name));
+        XSetClipMask(dpy, gc, None);
+    }
+}
+
+static void draw(void) {
+    char prompt[FILTER_MAX + 16];
+
+    XRenderFillRectangle(dpy, PictOpSrc, back_picture, &bg_color,
+                         0, 0, screen_width, ascent + 2 * CELL_PAD);
+    if (fontset) {
+        snprintf(prompt, sizeof(prompt), "%s_", filter);
+        XSetForeground(dpy, gc, config.bar_fg);
+        Xutf8DrawString(dpy, back, fontset, gc, CELL_PAD, CELL_PAD + ascent,
+                        prompt, strlen(prompt));
+    }
+    if (!num_shown) {
+        XRenderFillRectangle(dpy, PictOpSrc, back_picture, &bg_color,
+                             0, ascent + 2 * CELL_PAD, screen_width, screen_height);
+    }
+    for (int i = 0; i < num_shown; i++) {
+        draw_cell(i);
+    }
+    /* Whatever the grid does not cover */
+    int rows = num_shown ? (num_shown + cols - 1) / cols : 0;
+    int used = ascent + 2 * CELL_PAD + rows * cell_h;
+    if (num_shown && used < screen_height) {
+        XRenderFillRectangle(dpy, PictOpSrc, back_picture, &bg_color,
+                             0, used, screen_width, screen_height - used);
+    }
+    XCopyArea(dpy, back, win, gc, 0, 0, screen_width, screen_height, 0, 0);
+}
+
+static void close_overview(void) {
+    if (!active) {
+        return;
+    }
+    active = false;
+    XUngrabKeyboard(dpy, CurrentTime);
+    XUngrabPointer(dpy, CurrentTime);
+    XUnmapWindow(dpy, win);
+}
+
+static void choose(Client *c) {
+    close_overview();
+    focus_client(c);
+    /* Monocle only shows the selected window */
+    if (c->is_hidden) {
+        apply_layout();
+    }
+}
+
+static void open_overview(void) {
+    trace_begin("open_overview", "overview");
+    filter[0] = '\0';
+    selected = 0;
+    collect();
+    /* Start on the previously focused window, like focus_mru */
+    if (num_shown > 1 && shown[0] == mon->selected) {
+        selected = 1;
+    }
+    active = true;
+    XMapRaised(dpy, win);
+    XGrabKeyboard(dpy, win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+    XGrabPointer(dpy, win, True, ButtonPressMask, GrabModeAsync, GrabModeAsync,
+                 None, None, CurrentTime);
+    draw();
+    /* Thumbnails of new windows are filled in after the first frame */
+    bool stale = false;
+    for (int i = 0; i < num_shown; i++) {
+        if (!shown[i]->thumb) {
+            new_thumbnail(shown[i]);
+        }
+        stale |= shown[i]->thumb && shown[i]->thumb->dirty;
+    }
+    if (stale) {
+        /* Sooner than the closed-overview delay it may be armed with */
+        timer_armed = false;
+        arm_timer();
+    }
+    trace_end();
+}
+
+void overview(const char *arg) {
+    (void)arg;
+
+    if (!enabled) {
+        return;
+    }
+    if (active) {
+        close_overview();
+    } else {
+        open_overview();
+    }
+}
+
+static void on_key(XKeyEvent *ev) {
+    char text[16];
+    KeySym keysym;
+    int len = XLookupString(ev, text, sizeof(text) - 1, &keysym, NULL);
+    size_t n = strlen(filter);
+
+    switch (keysym) {
+    case XK_Escape:
+        close_overview();
+        return;
+    case XK_Return:
+    case XK_KP_Enter:
+        if (num_shown) {
+            choose(shown[selected]);
+        }
+        return;
+    case XK_Left:
+    case XK_ISO_Left_Tab:
+        selected = num_shown ? (selected + num_shown - 1) % num_shown : 0;
+        break;
+    case XK_Right:
+    case XK_Tab:
+        selected = num_shown ? (selected + 1) % num_shown : 0;
+        break;
+    case XK_Up:
+        if (selected >= cols) {
+            selected -= cols;
+        }
+        break;
+    case XK_Down:
+        if (selected + cols < num_shown) {
+            selected += cols;
+        }
+        break;
+    case XK_BackSpace:
+        if (n) {
+            filter[n - 1] = '\0';
+            selected = 0;
+            collect();
+        }
+        break;
+    default:
+        if (len != 1 || !isprint((unsigned char)text[0]) || n + 1 >= FILTER_MAX) {
+            return;
+        }
+        filter[n] = text[0];
+        filter[n + 1] = '\0';
+        selected = 0;
+        collect();
+        /* Typed far enough to leave one candidate */
+        if (num_shown == 1) {
+            choose(shown[0]);
+            return;
+        }
+        break;
+    }
+    draw();
+}
+
+static void on_click(XButtonEvent *ev) {
+    int y = ev->y - ascent - 2 * CELL_PAD;
+    int i;
+
+    if (y < 0 || !cell_w || !cell_h) {
+        return;
+    }
+    i = (y / cell_h) * cols + ev->x / cell_w;
+    if (i < num_shown) {
+        choose(shown[i]);
+    } else {
+        close_overview();
+    }
+}
+
+/* Events for the overview window and damage reports; true when consumed */
+bool overview_event(XEvent *ev) {
+    if (!enabled) {
+        return false;
+    }
+#ifdef XDAMAGE
+    if (ev->type == damage_event + XDamageNotify) {
+        Client *c = find_client(((XDamageNotifyEvent *)ev)->drawable);
+        if (c) {
+            mark_dirty(c);
+        }
+        return true;
+    }
+#endif
+    if (!active || ev->xany.window != win) {
+        return false;
+    }
+    switch (ev->type) {
+    case KeyPress:
+        on_key(&ev->xkey);
+        break;
+    case ButtonPress:
+        on_click(&ev->xbutton);
+        break;
+    case Expose:
+        if (ev->xexpose.count == 0) {
+            XCopyArea(dpy, back, win, gc, 0, 0, screen_width, screen_height, 0, 0);
+        }
+        break;
+    }
+    return true;
+}
+
+/* A window destroyed since it was marked dirty fails to render; its
+ * DestroyNotify is on the way and forgets the thumbnail.  Likewise for
+ * a window destroyed right after it was withdrawn. */
+static int thumbnail_error(Display *d, XErrorEvent *ee) {
+    (void)d;
+    (void)ee;
+    return 0;
+}
+
+/* Refresh what changed, in one batch */
+static void on_timer(int fd, short revents) {
+    int (*old)(Display *, XErrorEvent *);
+    uint64_t expirations;
+    bool redraw = false;
+
+    (void)revents;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    timer_armed = false;
+    old = XSetErrorHandler(thumbnail_error);
+    for (Client *c = mon->clients; c; c = c->next) {
+        if (c->thumb && c->thumb->dirty) {
+            render_thumbnail(c);
+            redraw = true;
+        }
+    }
+    /* One round trip per batch, so the errors arrive while trapped */
+    if (redraw) {
+        XSync(dpy, False);
+    }
+    XSetErrorHandler(old);
+    if (active && redraw) {
+        collect();
+        draw();
+    }
+}
+
+#ifndef XDAMAGE
+/* Without damage reports, take the picture the user last saw */
+void overview_unfocus(Client *c) {
+    if (enabled) {
+        if (!c->thumb) {
+            new_thumbnail(c);
+        }
+        mark_dirty(c);
+    }
+}
+#else
+void overview_unfocus(Client *c) {
+    if (enabled && !c->thumb) {
+        new_thumbnail(c);
+    }
+}
+#endif
+
+/* Called when a client is managed and when it enters or leaves
+ * fullscreen: a fullscreen window goes straight to the screen, so the
+ * server can flip to it instead of copying it every frame */
+void overview_redirect(Client *c) {
+    bool redirect = enabled && !c->is_fullscreen;
+
+    if (redirect == c->redirected) {
+        return;
+    }
+    if (redirect) {
+        XCompositeRedirectWindow(dpy, c->win, CompositeRedirectAutomatic);
+    } else {
+        XCompositeUnredirectWindow(dpy, c->win, CompositeRedirectAutomatic);
+    }
+    c->redirected = redirect;
+}
+
+void overview_forget(Client *c) {
+    Thumbnail *t = c->thumb;
+    int (*old)(Display *, XErrorEvent *);
+    bool held = c->redirected;
+
+#ifdef XDAMAGE
+    held |= t != NULL;
+#endif
+    /* The server frees the damage object and the redirection along with
+     * a destroyed window, but a withdrawn one outlives being unmanaged */
+    if (held && !c->destroyed) {
+        old = XSetErrorHandler(thumbnail_error);
+        if (c->redirected) {
+            XCompositeUnredirectWindow(dpy, c->win, CompositeRedirectAutomatic);
+        }
+#ifdef XDAMAGE
+        if (t) {
+            XDamageDestroy(dpy, t->damage);
+        }
+#endif
+        XSync(dpy, False);
+        XSetErrorHandler(old);
+    }
+    c->redirected = false;
+    if (!t) {
+        return;
+    }
+    c->thumb = NULL;
+    if (t->picture) {
+        XRenderFreePicture(dpy, t->picture);
+        XFreePixmap(dpy, t->pixmap);
+    }
+    free(t);
+    if (!active) {
+        return;
+    }
+    /* The window may be gone; it must not stay in the grid */
+    collect();
+    draw();
+}
+
+bool overview_enabled(void) {
+    return enabled;
+}
+
+void create_overview(void) {
+    XSetWindowAttributes wa;
+    XFontSetExtents *extents;
+    char **missing, *def;
+    int nmissing, event_base, error_base, major = 0, minor = 2;
+
+    if (!dpy || !config.overview) {
+        return;
+    }
+    if (!XCompositeQueryExtension(dpy, &event_base, &error_base) ||
+        !XCompositeQueryVersion(dpy, &major, &minor) || (major == 0 && minor < 2) ||
+        !XRenderQueryExtension(dpy, &event_base, &error_base)) {
+        fprintf(stderr, "swm: no Composite 0.2 or Render, overview disabled\n");
+        return;
+    }
+#ifdef XDAMAGE
+    if (!XDamageQueryExtension(dpy, &damage_event, &error_base)) {
+        fprintf(stderr, "swm: no Damage, overview disabled\n");
+        return;
+    }
+#endif
+    if ((fontset = XCreateFontSet(dpy, config.font, &missing, &nmissing, &def))) {
+        extents = XExtentsOfFontSet(fontset);
+        ascent = -extents->max_logical_extent.y;
+    }
+    if (missing) {
+        XFreeStringList(missing);
+    }
+
+    wa.override_redirect = True;
+    wa.event_mask = ExposureMask | KeyPressMask | ButtonPressMask;
+    win = XCreateWindow(dpy, root, 0, 0, screen_width, screen_height, 0,
+                        DefaultDepth(dpy, screen), CopyFromParent,
+                        DefaultVisual(dpy, screen),
+                        CWOverrideRedirect | CWEventMask, &wa);
+    back = XCreatePixmap(dpy, root, screen_width, screen_height, DefaultDepth(dpy, screen));
+    back_picture = XRenderCreatePicture(dpy, back,
+        XRenderFindVisualFormat(dpy, DefaultVisual(dpy, screen)), 0, NULL);
+    gc = XCreateGC(dpy, root, 0, NULL);
+
+    if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) >= 0) {
+        watch_fd(timer_fd, POLLIN, on_timer);
+    }
+    enabled = true;
+    for (Client *c = mon->clients; c; c = c->next) {
+        overview_redirect(c);
+    }
+}
+
+void destroy_overview(void) {
+    if (!enabled) {
+        return;
+    }
+    close_overview();
+    for (Client *c = mon->clients; c; c = c->next) {
+        overview_forget(c);
+    }
+    if (timer_fd >= 0) {
+        unwatch_fd(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+    }
+    free(shown);
+    shown = NULL;
+    num_shown = capacity = 0;
+    XRenderFreePicture(dpy, back_picture);
+    XFreePixmap(dpy, back);
+    XFreeGC(dpy, gc);
+    XDestroyWindow(dpy, win);
+    if (fontset) {
+        XFreeFontSet(dpy, fontset);
+    }
+    enabled = false;
+    for (Client *c = mon->clients; c; c = c->next) {
+        overview_redirect(c);
+    }
+}
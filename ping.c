@@ -0,0 +1,172 @@
+/*
+ * Hung Client Detection
+ *
+ * Clients that list _NET_WM_PING in WM_PROTOCOLS are pinged every
+ * PING_INTERVAL seconds and whenever they are killed.  Nothing waits for
+ * the answer: the main loop's timer checks what is still in flight, and a
+ * client that has not answered within PING_TIMEOUT is marked unresponsive
+ * and drawn with BORDER_UNRESPONSIVE until it does.  Killing a window
+ * again within KILL_TIMEOUT escalates to SIGKILL and XKillClient unless
+ * it answered in between, in which case it is alive and the repeat is
+ * dropped instead of queueing another WM_DELETE_WINDOW.  Processes that
+ * freeze.c paused are left out, and their pending pings are forgotten.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "swm.h"
+
+static void on_timer(int fd, short revents);
+
+static Deadline timer = { -1, 0, on_timer };
+static long long round_ns;      /* next periodic round, 0 for none */
+
+/* One ping in flight per client; the client echoes the timestamp */
+void ping_client(Client *c) {
+    long long now = now_ns();
+    unsigned long serial = (unsigned long)(now / 1000000) & 0xffffffffUL;
+    XEvent ev;
+
+    /* A frozen process cannot answer */
+    if (!c->can_ping || c->ping.serial || client_frozen(c)) {
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.type = ClientMessage;
+    ev.xclient.window = c->win;
+    ev.xclient.message_type = wmatom[WMProtocols];
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = netatom[NetWMPing];
+    ev.xclient.data.l[1] = serial ? serial : 1;
+    ev.xclient.data.l[2] = c->win;
+    be->send_event(c->win, NoEventMask, &ev);
+    c->ping.serial = ev.xclient.data.l[1];
+    c->ping.sent_ns = now;
+    stats.pings++;
+    arm_deadline(&timer, now + config.ping_timeout * 1000000LL);
+}
+
+/* The client sends the ping back to the root window */
+void ping_reply(XClientMessageEvent *ev) {
+    Client *c = find_client((Window)ev->data.l[2]);
+    unsigned long rtt;
+
+    if (!c || !c->ping.serial || (unsigned long)ev->data.l[1] != c->ping.serial) {
+        return;
+    }
+    rtt = (now_ns() - c->ping.sent_ns) / 1000;
+    c->ping.serial = 0;
+    c->ping.last_us = rtt;
+    if (rtt > c->ping.max_us) {
+        c->ping.max_us = rtt;
+    }
+    c->ping.answered++;
+    if (c->ping.unresponsive) {
+        c->ping.unresponsive = false;
+        update_border(c);
+    }
+}
+
+/* Called when the process is frozen: whatever was in flight will not be
+ * answered until it runs again, which says nothing about it hanging */
+void cancel_ping(Client *c) {
+    c->ping.serial = 0;
+    if (c->ping.unresponsive) {
+        c->ping.unresponsive = false;
+        update_border(c);
+    }
+}
+
+/* Start a round when it is due, then mark whatever timed out */
+static void on_timer(int fd, short revents) {
+    long long now = now_ns(), timeout = config.ping_timeout * 1000000LL;
+    long long next;
+
+    (void)fd;
+    (void)revents;
+    if (!deadline_expired(&timer)) {
+        return;
+    }
+    if (round_ns && now >= round_ns) {
+        round_ns = now + config.ping_interval * 1000000000LL;
+        for (Client *c = mon->clients; c; c = c->next) {
+            ping_client(c);
+        }
+    }
+    next = round_ns;
+    for (Client *c = mon->clients; c; c = c->next) {
+        if (!c->ping.serial || c->ping.unresponsive) {
+            continue;
+        }
+        if (now - c->ping.sent_ns >= timeout) {
+            c->ping.unresponsive = true;
+            stats.pings_timed_out++;
+            update_border(c);
+        } else if (!next || c->ping.sent_ns + timeout < next) {
+            next = c->ping.sent_ns + timeout;
+        }
+    }
+    if (next) {
+        arm_deadline(&timer, next);
+    }
+}
+
+static void force_kill(Client *c) {
+    trace_begin("force_kill", "ping");
+    /* XKillClient first and synchronously: once SIGKILL closed the
+     * client's connection, its window ID is stale */
+    be->kill(c->win);
+    be->sync();
+    if (c->pid > 0 && c->pid != getpid()) {
+        kill(c->pid, SIGKILL);
+    }
+    stats.kills_forced++;
+    trace_end();
+}
+
+/* Called by kill_client(): true when an earlier kill of c is recent
+ * enough that this one escalates or is dropped */
+bool kill_pending(Client *c) {
+    long long now = now_ns();
+
+    if (!c->kill_ns || now - c->kill_ns >= config.kill_timeout * 1000000000LL) {
+        c->kill_ns = now;
+        return false;
+    }
+    /* It answered since: alive, probably asking about unsaved work */
+    if (c->can_ping && !c->ping.serial) {
+        return true;
+    }
+    force_kill(c);
+    return true;
+}
+
+/* Part of print_stats() */
+void print_pings(FILE *fp) {
+    fprintf(fp, "pings: %lu sent, %lu timed out, %lu kills forced\n",
+            stats.pings, stats.pings_timed_out, stats.kills_forced);
+    for (Client *c = mon ? mon->clients : NULL; c; c = c->next) {
+        if (!c->ping.answered && !c->ping.unresponsive) {
+            continue;
+        }
+        fprintf(fp, "  0x%-8lx rtt %7.2f ms  max %7.2f ms  %lu answered%s  %s\n",
+                c->win, c->ping.last_us / 1e3, c->ping.max_us / 1e3,
+                c->ping.answered, c->ping.unresponsive ? "  UNRESPONSIVE" : "", c->name);
+    }
+}
+
+void create_ping(void) {
+    if (config.ping_interval > 0) {
+        round_ns = now_ns() + config.ping_interval * 1000000000LL;
+        arm_deadline(&timer, round_ns);
+    }
+}
+
+void destroy_ping(void) {
+    stop_deadline(&timer);
+    round_ns = 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Event Trace Recording and Replay
+ *
+ * A trace is a small header followed by one record per dispatched event:
+ * the time since the previous record, the event type and the bytes of the
+ * matching XEvent union member.  Key events also carry the keysym they
+ * resolved to, so a trace replays on the mock backend too.  Replay feeds
+ * the records back through handle_event() at full speed and reports where
+ * the time went.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include "swm.h"
+
+#define TRACE_MAGIC     "SWMT"
+#define TRACE_VERSION   2
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t event_size;
+    uint32_t screen_w, screen_h;
+} TraceHeader;
+
+/* Idle gaps longer than UINT32_MAX us (about 71 minutes) are stored as
+ * that; replay runs at full speed and only sums them for the report */
+typedef struct {
+    uint32_t delta_us;
+    uint16_t type;
+    uint16_t size;
+} TraceRecord;
+
+/* Bytes actually used by each event type; everything else is stored whole */
+static const uint16_t event_size[LASTEvent] = {
+    [KeyPress] = sizeof(XKeyEvent),
+    [KeyRelease] = sizeof(XKeyEvent),
+    [ButtonPress] = sizeof(XButtonEvent),
+    [ButtonRelease] = sizeof(XButtonEvent),
+    [MotionNotify] = sizeof(XMotionEvent),
+    [EnterNotify] = sizeof(XCrossingEvent),
+    [LeaveNotify] = sizeof(XCrossingEvent),
+    [FocusIn] = sizeof(XFocusChangeEvent),
+    [FocusOut] = sizeof(XFocusChangeEvent),
+    [Expose] = sizeof(XExposeEvent),
+    [CreateNotify] = sizeof(XCreateWindowEvent),
+    [DestroyNotify] = sizeof(XDestroyWindowEvent),
+    [UnmapNotify] = sizeof(XUnmapEvent),
+    [MapNotify] = sizeof(XMapEvent),
+    [MapRequest] = sizeof(XMapRequestEvent),
+    [ReparentNotify] = sizeof(XReparentEvent),
+    [ConfigureNotify] = sizeof(XConfigureEvent),
+    [ConfigureRequest] = sizeof(XConfigureRequestEvent),
+    [PropertyNotify] = sizeof(XPropertyEvent),
+    [ClientMessage] = sizeof(XClientMessageEvent),
+    [MappingNotify] = sizeof(XMappingEvent),
+};
+
+static const char *event_names[LASTEvent] = {
+    [KeyPress] = "KeyPress",
+    [KeyRelease] = "KeyRelease",
+    [ButtonPress] = "ButtonPress",
+    [ButtonRelease] = "ButtonRelease",
+    [MotionNotify] = "MotionNotify",
+    [EnterNotify] = "EnterNotify",
+    [LeaveNotify] = "LeaveNotify",
+    [FocusIn] = "FocusIn",
+    [FocusOut] = "FocusOut",
+    [Expose] = "Expose",
+    [CreateNotify] = "CreateNotify",
+    [DestroyNotify] = "DestroyNotify",
+    [UnmapNotify] = "UnmapNotify",
+    [MapNotify] = "MapNotify",
+    [MapRequest] = "MapRequest",
+    [ReparentNotify] = "ReparentNotify",
+    [ConfigureNotify] = "ConfigureNotify",
+    [ConfigureRequest] = "ConfigureRequest",
+    [PropertyNotify] = "PropertyNotify",
+    [ClientMessage] = "ClientMessage",
+    [MappingNotify] = "MappingNotify",
+};
+
+const char *event_name(int type) {
+    if (type >= 0 && type < LASTEvent && event_names[type]) {
+        return event_names[type];
+    }
+    return "?";
+}
+
+static FILE *record_fp = NULL;
+static uint64_t record_last;
+static int replay_errors;
+
+static uint64_t now_us(void) {
+    return now_ns() / 1000;
+}
+
+static uint16_t payload_size(int type) {
+    if (type >= 0 && type < LASTEvent && event_size[type]) {
+        return event_size[type];
+    }
+    return sizeof(XEvent);
+}
+
+void record_start(const char *path) {
+    TraceHeader h;
+
+    if (!(record_fp = fopen(path, "wb"))) {
+        die("Cannot open trace file for writing");
+    }
+    setvbuf(record_fp, NULL, _IOFBF, 1 << 16);
+
+    memcpy(h.magic, TRACE_MAGIC, 4);
+    h.version = TRACE_VERSION;
+    h.event_size = sizeof(XEvent);
+    h.screen_w = screen_width;
+    h.screen_h = screen_height;
+    fwrite(&h, sizeof(h), 1, record_fp);
+    record_last = now_us();
+}
+
+void record_event(const XEvent *ev) {
+    TraceRecord r;
+    uint64_t now;
+
+    if (!record_fp) {
+        return;
+    }
+
+    now = now_us();
+    r.delta_us = now - record_last > UINT32_MAX ? UINT32_MAX : (uint32_t)(now - record_last);
+    r.type = ev->type;
+    r.size = payload_size(ev->type);
+    record_last = now;
+
+    if ((ev->type == KeyPress || ev->type == KeyRelease) && dpy) {
+        uint32_t keysym = XLookupKeysym((XKeyEvent *)&ev->xkey, 0);
+        r.size += sizeof(keysym);
+        fwrite(&r, sizeof(r), 1, record_fp);
+        fwrite(ev, r.size - sizeof(keysym), 1, record_fp);
+        fwrite(&keysym, sizeof(keysym), 1, record_fp);
+        return;
+    }
+    fwrite(&r, sizeof(r), 1, record_fp);
+    fwrite(ev, r.size, 1, record_fp);
+}
+
+/* Windows adopted by scan() never produce a MapRequest; fake one so the
+ * replayed session starts with the same clients */
+void record_adopted(Window w) {
+    XEvent ev;
+
+    if (!record_fp) {
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.xmaprequest.type = MapRequest;
+    ev.xmaprequest.parent = root;
+    ev.xmaprequest.window = w;
+    record_event(&ev);
+}
+
+/* Once per event drain, so a crash loses at most the events of the drain
+ * it happened in */
+void record_flush(void) {
+    if (record_fp) {
+        fflush(record_fp);
+    }
+}
+
+void record_stop(void) {
+    if (!record_fp) {
+        return;
+    }
+    fclose(record_fp);
+    record_fp = NULL;
+}
+
+static int replay_xerror(Display *d, XErrorEvent *ee) {
+    (void)d;
+    (void)ee;
+    replay_errors++;
+    return 0;
+}
+
+void replay(const char *path) {
+    FILE *fp;
+    TraceHeader h;
+    TraceRecord r;
+    XEvent ev;
+    unsigned long count[LASTEvent] = {0};
+    uint64_t time_ns[LASTEvent] = {0};
+    uint64_t max_ns[LASTEvent] = {0};
+    unsigned long requests[LASTEvent] = {0};
+    unsigned long total = 0, total_requests = 0;
+    uint64_t total_ns = 0, recorded_us = 0;
+
+    if (!(fp = fopen(path, "rb"))) {
+        die("Cannot open trace file");
+    }
+    if (fread(&h, sizeof(h), 1, fp) != 1 ||
+        memcmp(h.magic, TRACE_MAGIC, 4) != 0 ||
+        h.version != TRACE_VERSION || h.event_size != sizeof(XEvent)) {
+        die("Not a compatible swm trace");
+    }
+
+    if (dpy) {
+        XSetErrorHandler(replay_xerror);
+    }
+
+    while (fread(&r, sizeof(r), 1, fp) == 1) {
+        uint32_t keysym = NoSymbol;
+        size_t size = r.size;
+
+        if (r.type < LASTEvent && size == payload_size(r.type) + sizeof(keysym)) {
+            size -= sizeof(keysym);
+        } else if (size > sizeof(XEvent)) {
+            die("Corrupt swm trace");
+        }
+        memset(&ev, 0, sizeof(ev));
+        if ((size && fread(&ev, size, 1, fp) != 1) ||
+            (size != r.size && fread(&keysym, sizeof(keysym), 1, fp) != 1)) {
+            break;
+        }
+        ev.xany.display = dpy;
+        if (keysym != NoSymbol) {
+            mock_set_keysym(ev.xkey.keycode, keysym);
+        }
+        recorded_us += r.delta_us;
+
+        unsigned long seq = be->requests();
+        uint64_t start = now_ns();
+        handle_event(&ev);
+        update_stack();
+        update_snapshot();
+        uint64_t elapsed = now_ns() - start;
+        unsigned long issued = be->requests() - seq;
+
+        if (ev.type >= 0 && ev.type < LASTEvent) {
+            count[ev.type]++;
+            time_ns[ev.type] += elapsed;
+            requests[ev.type] += issued;
+            if (elapsed > max_ns[ev.type]) {
+                max_ns[ev.type] = elapsed;
+            }
+        }
+        total++;
+        total_ns += elapsed;
+        total_requests += issued;
+    }
+    fclose(fp);
+    be->sync();
+
+    fprintf(stderr, "swm: replayed %lu events (%.3f s recorded) in %.3f ms\n",
+            total, recorded_us / 1e6, total_ns / 1e6);
+    fprintf(stderr, "%-18s %8s %12s %10s %10s %10s\n",
+            "event", "count", "total_us", "avg_ns", "max_ns", "requests");
+    for (int i = 0; i < LASTEvent; i++) {
+        if (!count[i]) {
+            continue;
+        }
+        fprintf(stderr, "%-18s %8lu %12.1f %10llu %10llu %10lu\n",
+                event_names[i] ? event_names[i] : "?", count[i],
+                time_ns[i] / 1e3,
+                (unsigned long long)(time_ns[i] / count[i]),
+                (unsigned long long)max_ns[i], requests[i]);
+    }
+    fprintf(stderr, "total X requests: %lu, X errors: %d (%s backend)\n",
+            total_requests, replay_errors, be->name);
+    print_stats(stderr);
+    if (be->report) {
+        be->report(stderr);
+    }
+}
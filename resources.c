@@ -0,0 +1,139 @@
+/*
+ * X Resource Accounting
+ *
+ * Asks the server, through the X-Resource extension, how many resources
+ * and how many bytes of pixmaps each managed window's client holds, so a
+ * client that leaks server memory shows up before the server swaps.
+ * Sampled every RESOURCE_INTERVAL seconds and whenever SIGUSR1 asks for
+ * the stats, which are then printed to stderr with one line per client.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "swm.h"
+
+static int signal_fd = -1;
+static int timer_fd = -1;
+
+static void sample(ResourceUsage *r, Window win) {
+    unsigned long count, bytes;
+
+    if (!be->client_resources(win, &count, &bytes)) {
+        return;
+    }
+    if (!r->samples++) {
+        r->first_pixmap_bytes = bytes;
+    }
+    r->count = count;
+    r->pixmap_bytes = bytes;
+    stats.resource_queries++;
+}
+
+void update_resources(void) {
+    trace_begin("update_resources", "resources");
+    for (Client *c = mon->clients; c; c = c->next) {
+        sample(&c->res, c->win);
+    }
+    for (TrayClient *tc = tray ? tray->clients : NULL; tc; tc = tc->next) {
+        sample(&tc->res, tc->win);
+    }
+    trace_end();
+}
+
+static void print_usage(FILE *fp, const ResourceUsage *r, Window win, pid_t pid,
+                        const char *name) {
+    if (!r->samples) {
+        return;
+    }
+    fprintf(fp, "  0x%-8lx pid %-7d resources %-6lu pixmaps %8.1f KiB (%+.1f since mapped)  %s\n",
+            win, (int)pid, r->count, r->pixmap_bytes / 1024.0,
+            ((double)r->pixmap_bytes - r->first_pixmap_bytes) / 1024.0, name);
+}
+
+/* Part of print_stats(), from the last sample */
+void print_resources(FILE *fp) {
+    unsigned long count = 0, bytes = 0;
+
+    if (!mon) {
+        return;
+    }
+    for (Client *c = mon->clients; c; c = c->next) {
+        count += c->res.count;
+        bytes += c->res.pixmap_bytes;
+    }
+    for (TrayClient *tc = tray ? tray->clients : NULL; tc; tc = tc->next) {
+        count += tc->res.count;
+        bytes += tc->res.pixmap_bytes;
+    }
+    fprintf(fp, "x resources: %lu queries, %lu held, %.1f KiB in pixmaps\n",
+            stats.resource_queries, count, bytes / 1024.0);
+    for (Client *c = mon->clients; c; c = c->next) {
+        print_usage(fp, &c->res, c->win, c->pid, c->name);
+    }
+    for (TrayClient *tc = tray ? tray->clients : NULL; tc; tc = tc->next) {
+        print_usage(fp, &tc->res, tc->win, 0, "(tray icon)");
+    }
+}
+
+static void on_signal(int fd, short revents) {
+    struct signalfd_siginfo si;
+
+    (void)revents;
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        update_resources();
+        print_stats(stderr);
+    }
+}
+
+static void on_timer(int fd, short revents) {
+    uint64_t expirations;
+
+    (void)revents;
+    if (read(fd, &expirations, sizeof(expirations)) >= 0) {
+        update_resources();
+    }
+}
+
+/* Before any thread starts, so they all inherit the blocked signal */
+void create_resources(void) {
+    struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+    unsigned long count, bytes;
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == 0 &&
+        (signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) >= 0) {
+        watch_fd(signal_fd, POLLIN, on_signal);
+    }
+
+    /* Sample on a timer only if the server can answer at all */
+    if (config.resource_interval <= 0 || !be->client_resources(root, &count, &bytes) ||
+        (timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+        return;
+    }
+    its.it_value.tv_sec = its.it_interval.tv_sec = config.resource_interval;
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    watch_fd(timer_fd, POLLIN, on_timer);
+}
+
+void destroy_resources(void) {
+    if (signal_fd >= 0) {
+        unwatch_fd(signal_fd);
+        close(signal_fd);
+        signal_fd = -1;
+    }
+    if (timer_fd >= 0) {
+        unwatch_fd(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+    }
+}
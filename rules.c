@@ -0,0 +1,191 @@
+/*
+ * Window Rules
+ *
+ * The rules table from config.h is compiled once at startup into hash
+ * tables keyed on the WM_CLASS class and instance strings, so matching a
+ * new window only looks at rules that can apply to it.  Rules are applied
+ * in create_client(), before the client is attached, so the first layout
+ * pass already places the window where the rules want it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include "swm.h"
+
+#define RULE_BUCKETS    64
+#define CLASS_MAX       256
+#define ROLE_MAX        128
+
+typedef struct RuleEntry {
+    const char *key;
+    int index;
+    struct RuleEntry *next;
+} RuleEntry;
+
+static RuleEntry *by_class[RULE_BUCKETS];
+static RuleEntry *by_instance[RULE_BUCKETS];
+static int *wildcard;
+static int num_wildcard;
+static Atom wm_window_role;
+
+static unsigned int hash(const char *s) {
+    unsigned int h = 2166136261u;
+
+    while (*s) {
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+    return h % RULE_BUCKETS;
+}
+
+static void insert(RuleEntry **table, const char *key, int index) {
+    RuleEntry *e = calloc(1, sizeof(RuleEntry));
+    RuleEntry **p;
+
+    e->key = key;
+    e->index = index;
+    /* Keep each chain in config order */
+    for (p = &table[hash(key)]; *p; p = &(*p)->next);
+    *p = e;
+}
+
+void compile_rules(void) {
+    wm_window_role = be->intern_atom("WM_WINDOW_ROLE");
+    wildcard = calloc(config.num_rules ? config.num_rules : 1, sizeof(int));
+
+    for (int i = 0; i < config.num_rules; i++) {
+        const Rule *r = &config.rules[i];
+        if (r->class) {
+            insert(by_class, r->class, i);
+        } else if (r->instance) {
+            insert(by_instance, r->instance, i);
+        } else {
+            wildcard[num_wildcard++] = i;
+        }
+    }
+}
+
+void free_rules(void) {
+    for (int i = 0; i < RULE_BUCKETS; i++) {
+        RuleEntry *e, *next;
+        for (e = by_class[i]; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+        for (e = by_instance[i]; e; e = next) {
+            next = e->next;
+            free(e);
+        }
+        by_class[i] = by_instance[i] = NULL;
+    }
+    free(wildcard);
+    wildcard = NULL;
+    num_wildcard = 0;
+}
+
+static bool matches(const Rule *r, const char *class, const char *instance,
+                    const char *title, const char *role) {
+    return (!r->class || !strcmp(r->class, class)) &&
+           (!r->instance || !strcmp(r->instance, instance)) &&
+           (!r->title || strstr(title, r->title)) &&
+           (!r->role || !strcmp(r->role, role));
+}
+
+static void apply(Client *c, const Rule *r) {
+    if (r->floating >= 0) {
+        c->is_floating = r->floating;
+    }
+    if (r->fullscreen >= 0) {
+        c->is_fullscreen = r->fullscreen;
+    }
+    if (r->master >= 0) {
+        c->to_stack = r->master == 0;
+    }
+    if (r->hide != HideDefault) {
+        c->hide = r->hide;
+    }
+    if (r->border_width >= 0) {
+        c->bw = r->border_width;
+    }
+    if (r->freeze != FreezeNone) {
+        c->freeze = r->freeze;
+    }
+    stats.rules_applied++;
+}
+
+/* Collect candidate rule indices from one hash chain */
+static int collect(RuleEntry **table, const char *key, int *out, int n) {
+    for (RuleEntry *e = table[hash(key)]; e; e = e->next) {
+        if (!strcmp(e->key, key)) {
+            out[n++] = e->index;
+        }
+    }
+    return n;
+}
+
+/* The reads apply_rules() makes, so they can be prefetched with the rest */
+int rule_properties(PropertyRequest *req) {
+    if (!config.num_rules) {
+        return 0;
+    }
+    req[0] = (PropertyRequest){ XA_WM_CLASS, XA_STRING, CLASS_MAX / 4 };
+    req[1] = (PropertyRequest){ wm_window_role, XA_STRING, ROLE_MAX / 4 };
+    return 2;
+}
+
+void apply_rules(Client *c) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems;
+    unsigned char *data = NULL;
+    char class_hint[CLASS_MAX] = "", role[ROLE_MAX] = "";
+    const char *instance = "", *class = "";
+    int candidates[config.num_rules ? config.num_rules : 1];
+    int n = 0;
+
+    if (!config.num_rules) {
+        return;
+    }
+
+    /* WM_CLASS is "instance\0class\0" */
+    if (be->get_property(c->win, XA_WM_CLASS, XA_STRING, sizeof(class_hint) / 4,
+                         &actual_type, &actual_format, &nitems, &data) == Success && data) {
+        size_t len = nitems < sizeof(class_hint) - 1 ? nitems : sizeof(class_hint) - 1;
+        memcpy(class_hint, data, len);
+        class_hint[len] = '\0';
+        instance = class_hint;
+        if (strlen(instance) + 1 < len) {
+            class = instance + strlen(instance) + 1;
+        }
+        XFree(data);
+    }
+    if (be->get_property(c->win, wm_window_role, XA_STRING, sizeof(role) / 4,
+                         &actual_type, &actual_format, &nitems, &data) == Success && data) {
+        size_t len = nitems < sizeof(role) - 1 ? nitems : sizeof(role) - 1;
+        memcpy(role, data, len);
+        role[len] = '\0';
+        XFree(data);
+    }
+
+    n = collect(by_class, class, candidates, n);
+    n = collect(by_instance, instance, candidates, n);
+    for (int i = 0; i < num_wildcard; i++) {
+        candidates[n++] = wildcard[i];
+    }
+
+    /* Apply in config order so later rules override earlier ones */
+    for (int i = 1; i < n; i++) {
+        int v = candidates[i], j;
+        for (j = i; j > 0 && candidates[j - 1] > v; j--) {
+            candidates[j] = candidates[j - 1];
+        }
+        candidates[j] = v;
+    }
+    for (int i = 0; i < n; i++) {
+        const Rule *r = &config.rules[candidates[i]];
+        if (matches(r, class, instance, c->name, role)) {
+            apply(c, r);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/*
+ * Shared State Snapshot
+ *
+ * Publishes the monitor and client state in a shared-memory segment for
+ * external bars and scripts (layout in snapshot.h).  The snapshot is
+ * built once per event drain into a private copy and only written to the
+ * segment, under the seqlock, when something actually changed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "swm.h"
+#include "snapshot.h"
+
+static Snapshot *shared;
+static Snapshot *next;
+static char shm_name[64];
+
+void create_snapshot(void) {
+    const char *display = getenv("DISPLAY");
+    int fd;
+
+    snprintf(shm_name, sizeof(shm_name), "/swm-%s", display ? display : "none");
+    for (char *p = shm_name + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '_';
+        }
+    }
+    /* Titles are private: readable by this user only, and always a fresh
+     * segment, never one someone else created under the name */
+    shm_unlink(shm_name);
+    if ((fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+        fprintf(stderr, "swm: cannot create shared snapshot %s\n", shm_name);
+        return;
+    }
+    if (ftruncate(fd, sizeof(Snapshot)) < 0 ||
+        (shared = mmap(NULL, sizeof(Snapshot), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        shared = NULL;
+        shm_unlink(shm_name);
+    }
+    close(fd);
+    if (!shared) {
+        return;
+    }
+    next = calloc(1, sizeof(Snapshot));
+    shared->magic = next->magic = SNAPSHOT_MAGIC;
+    shared->version = next->version = SNAPSHOT_VERSION;
+}
+
+bool snapshot_enabled(void) {
+    return shared != NULL;
+}
+
+void update_snapshot(void) {
+    uint32_t n = 0;
+    uint32_t seq;
+
+    if (!shared || !mon) {
+        return;
+    }
+
+    /* Everything except the seqlock and update counter */
+    next->selected = mon->selected ? mon->selected->win : 0;
+    next->master_factor = mon->master_factor;
+    next->num_master = mon->num_master;
+    snprintf(next->layout, sizeof(next->layout), "%s", mon->layout ? mon->layout->name : "");
+    for (Client *c = mon->clients; c && n < SNAPSHOT_CLIENTS; c = c->next, n++) {
+        SnapshotClient *sc = &next->clients[n];
+        sc->window = c->win;
+        sc->x = c->x;
+        sc->y = c->y;
+        sc->w = c->w;
+        sc->h = c->h;
+        sc->flags = (c->is_floating ? SNAPSHOT_FLOATING : 0) |
+                    (c->is_fullscreen ? SNAPSHOT_FULLSCREEN : 0) |
+                    (c->is_hidden ? SNAPSHOT_HIDDEN : 0) |
+                    (c == mon->selected ? SNAPSHOT_SELECTED : 0);
+        snprintf(sc->name, sizeof(sc->name), "%s", c->name);
+    }
+    next->num_clients = n;
+
+    size_t used = offsetof(Snapshot, clients) + n * sizeof(SnapshotClient);
+    size_t head = offsetof(Snapshot, selected);
+    if (shared->num_clients == n &&
+        !memcmp((char *)shared + head, (char *)next + head, used - head)) {
+        return;
+    }
+
+    seq = shared->seq;
+    __atomic_store_n(&shared->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shared->num_clients = n;
+    shared->updates++;
+    memcpy((char *)shared + head, (char *)next + head, used - head);
+    __atomic_store_n(&shared->seq, seq + 2, __ATOMIC_RELEASE);
+    stats.snapshots++;
+}
+
+void destroy_snapshot(void) {
+    if (!shared) {
+        return;
+    }
+    munmap(shared, sizeof(Snapshot));
+    shm_unlink(shm_name);
+    free(next);
+    shared = NULL;
+    next = NULL;
+}
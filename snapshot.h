@@ -0,0 +1,60 @@
+/*
+ * Shared State Snapshot
+ *
+ * Layout of the shared-memory segment swm publishes at /dev/shm/swm-<display>
+ * (shm_open name "/swm-" followed by $DISPLAY).  Readers map it read-only
+ * and copy it with snapshot_read(): no system calls, no X traffic.  Only
+ * fixed-width types are used so readers need neither Xlib nor swm.h.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC      0x534e5753  /* "SWNS" */
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_CLIENTS    256
+#define SNAPSHOT_NAME_MAX   256
+
+/* SnapshotClient.flags */
+#define SNAPSHOT_FLOATING   (1 << 0)
+#define SNAPSHOT_FULLSCREEN (1 << 1)
+#define SNAPSHOT_HIDDEN     (1 << 2)
+#define SNAPSHOT_SELECTED   (1 << 3)
+
+typedef struct {
+    uint64_t window;
+    int32_t x, y, w, h;
+    uint32_t flags;
+    char name[SNAPSHOT_NAME_MAX];
+} SnapshotClient;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;               /* seqlock: odd while swm is writing */
+    uint32_t num_clients;       /* entries used in clients[], in layout order */
+    uint64_t updates;           /* snapshots published so far */
+    uint64_t selected;          /* focused window or 0 */
+    float master_factor;
+    int32_t num_master;
+    char layout[32];
+    SnapshotClient clients[SNAPSHOT_CLIENTS];
+} Snapshot;
+
+/* Copy a consistent snapshot out of the shared segment, retrying while
+ * swm is in the middle of an update */
+static inline void snapshot_read(const Snapshot *shared, Snapshot *out) {
+    uint32_t before, after;
+
+    do {
+        while ((before = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE)) & 1);
+        memcpy(out, shared, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&shared->seq, __ATOMIC_RELAXED);
+    } while (before != after);
+}
+
+#endif /* SNAPSHOT_H */
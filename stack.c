@@ -0,0 +1,207 @@
+/*
+ * Stacking Order
+ *
+ * Managed windows live in fixed layers, bottom to top: desktop, tiled,
+ * floating, above (_NET_WM_STATE_ABOVE), the tray and bar, and fullscreen
+ * windows over everything.  Within a layer the most recently focused
+ * window is on top, and transients sit right above the window they
+ * belong to, in its layer if that is higher.  Anything that can change
+ * the order calls stack_changed(); once per event drain the order is
+ * rebuilt and, only if it differs from what the server already has,
+ * pushed with a single XRestackWindows request.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "swm.h"
+
+enum { LayerDesktop, LayerTiled, LayerFloating, LayerAbove, LayerFullscreen, LayerLast };
+
+static Window *order, *pushed;
+static Client **by_win;         /* clients sorted by window, to find parents */
+static int num_pushed, capacity;
+static bool dirty;
+
+static int own_layer(Client *c) {
+    if (c->is_desktop) {
+        return LayerDesktop;
+    }
+    if (c->is_fullscreen) {
+        return LayerFullscreen;
+    }
+    if (c->is_above) {
+        return LayerAbove;
+    }
+    if (c->is_floating) {
+        return LayerFloating;
+    }
+    return LayerTiled;
+}
+
+static int compare_win(const void *a, const void *b) {
+    Window x = (*(Client *const *)a)->win, y = (*(Client *const *)b)->win;
+
+    return x < y ? -1 : x > y;
+}
+
+static Client *lookup(Window w, int n) {
+    int lo = 0, hi = n;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (by_win[mid]->win < w) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < n && by_win[lo]->win == w ? by_win[lo] : NULL;
+}
+
+/* True when following WM_TRANSIENT_FOR from c comes back to c */
+static bool in_cycle(Client *c, int n) {
+    Client *p = c->stack_parent;
+
+    for (int depth = 0; p && depth < n; depth++, p = p->stack_parent) {
+        if (p == c) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Parents, transient lists and layers, once per pass: O(n log n) plus
+ * the length of each transient chain with transients around, a flag per
+ * client without */
+static void resolve(int n, int num_transients) {
+    int i = 0;
+
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        c->stack_parent = c->transients = c->next_transient = NULL;
+        c->layer = own_layer(c);
+        by_win[i++] = c;
+    }
+    if (!num_transients) {
+        return;
+    }
+    qsort(by_win, n, sizeof(Client *), compare_win);
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        Client *p;
+        if (c->transient_for && (p = lookup(c->transient_for, n)) && p != c) {
+            c->stack_parent = p;
+        }
+    }
+    /* Windows transient for each other in a loop all count as roots; the
+     * layer is only a mark here, it is set again below */
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        c->layer = in_cycle(c, n) ? -1 : c->layer;
+    }
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        if (c->layer < 0) {
+            c->stack_parent = NULL;
+            c->layer = own_layer(c);
+        }
+    }
+    /* Pushed from the least recently focused, so lists end up MRU first */
+    for (Client *c = mon->mru_tail; c; c = c->mru_prev) {
+        Client *p = c->stack_parent;
+        if (p) {
+            c->next_transient = p->transients;
+            p->transients = c;
+        }
+    }
+    /* The highest layer along the chain, e.g. a dialog of a dialog of a
+     * fullscreen window stays over it */
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        for (Client *p = c->stack_parent; p; p = p->stack_parent) {
+            if (own_layer(p) > c->layer) {
+                c->layer = own_layer(p);
+            }
+        }
+    }
+}
+
+/* A window with its transients above it, most recently focused first.
+ * Cycles were broken in resolve(), so every chain ends at a root. */
+static int add_client(Client *c, int layer, int n) {
+    for (Client *t = c->transients; t; t = t->next_transient) {
+        if (t->layer == layer) {
+            n = add_client(t, layer, n);
+        }
+    }
+    order[n++] = c->win;
+    return n;
+}
+
+static int add_layer(int layer, int n) {
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        Client *p = c->stack_parent;
+        if (c->layer != layer) {
+            continue;
+        }
+        /* Placed with its parent */
+        if (p && p->layer == layer) {
+            continue;
+        }
+        n = add_client(c, layer, n);
+    }
+    return n;
+}
+
+void stack_changed(void) {
+    dirty = true;
+}
+
+void update_stack(void) {
+    Window bar;
+    int n = 0, need = 2, clients = 0, num_transients = 0;
+
+    if (!dirty || !mon) {
+        return;
+    }
+    dirty = false;
+
+    for (Client *c = mon->mru; c; c = c->mru_next) {
+        clients++;
+        num_transients += c->transient_for != None;
+    }
+    need += clients;
+    if (need > capacity) {
+        capacity = need * 2;
+        order = realloc(order, capacity * sizeof(Window));
+        pushed = realloc(pushed, capacity * sizeof(Window));
+        by_win = realloc(by_win, capacity * sizeof(Client *));
+    }
+    resolve(clients, num_transients);
+
+    /* Top to bottom, as XRestackWindows wants it */
+    n = add_layer(LayerFullscreen, n);
+    if (tray) {
+        order[n++] = tray->win;
+    }
+    if ((bar = bar_window())) {
+        order[n++] = bar;
+    }
+    for (int l = LayerFullscreen - 1; l >= 0; l--) {
+        n = add_layer(l, n);
+    }
+
+    if (n == num_pushed && !memcmp(order, pushed, n * sizeof(Window))) {
+        return;
+    }
+    if (n > 1) {
+        be->restack(order, n);
+        stats.restacks++;
+    }
+    memcpy(pushed, order, n * sizeof(Window));
+    num_pushed = n;
+}
+
+void free_stack(void) {
+    free(order);
+    free(pushed);
+    free(by_win);
+    order = pushed = NULL;
+    by_win = NULL;
+    num_pushed = capacity = 0;
+}
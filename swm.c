@@ -3,13 +3,21 @@
  * Main implementation
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/timerfd.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/Xproto.h>
 #include "swm.h"
 #include "config.h"
 
@@ -22,8 +30,9 @@ SystemTray *tray = NULL;
 int screen;
 int screen_width, screen_height;
 bool running = true;
-static Atom wm_protocols;
-static Atom wm_delete_window;
+Stats stats;
+Atom wmatom[WMLast];
+Atom netatom[NetLast];
 static Atom net_system_tray_opcode;
 static Atom net_system_tray_orientation;
 static Atom net_system_tray_selection;
@@ -37,66 +46,212 @@ static void (*event_handlers[LASTEvent])(XEvent *) = {
     [DestroyNotify] = on_destroy_notify,
     [EnterNotify] = on_enter_notify,
     [KeyPress] = on_key_press,
+    [KeyRelease] = on_key_release,
     [ButtonPress] = on_button_press,
     [ClientMessage] = on_client_message,
+    [PropertyNotify] = on_property_notify,
+    [Expose] = on_expose,
 };
 
+/* Root: map/configure requests and unmap/destroy of managed windows.
+ * Nothing else is selected there; every extra bit is a wakeup. */
+#define ROOT_EVENT_MASK (SubstructureRedirectMask | SubstructureNotifyMask)
+
+static long client_mask;
+static long long started_ns;
+static int (*xerror_default)(Display *d, XErrorEvent *ee);
+
+/* File descriptors serviced by the main loop besides the X connection */
+#define MAX_WATCHES 64
+
+static struct {
+    int fd;
+    short events;
+    WatchFunc func;
+} watches[MAX_WATCHES];
+static int num_watches;
+
 void die(const char *errstr) {
     fprintf(stderr, "swm: %s\n", errstr);
     exit(EXIT_FAILURE);
 }
 
 unsigned long get_color(const char *color) {
-    Colormap cmap = DefaultColormap(dpy, screen);
-    XColor xcolor;
+    return be->alloc_color(color);
+}
+
+/* The clock every timestamp and deadline in swm is taken from */
+long long now_ns(void) {
+    struct timespec ts;
     
-    if (!XAllocNamedColor(dpy, cmap, color, &xcolor, &xcolor)) {
-        die("Cannot allocate color");
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void print_stats(FILE *fp) {
+    double secs = started_ns ? (now_ns() - started_ns) / 1e9 : 0;
+    
+    fprintf(fp, "main loop wakeups: %lu (%.2f/s), events: %lu, "
+            "property changes ignored: %lu\n", stats.wakeups,
+            secs > 0 ? stats.wakeups / secs : 0.0, stats.events,
+            stats.properties_ignored);
+    fprintf(fp, "configure requests rejected: %lu\n", stats.configure_rejected);
+    fprintf(fp, "x errors ignored: %lu\n", stats.x_errors_ignored);
+    fprintf(fp, "bar segments redrawn: %lu\n", stats.bar_redraws);
+    fprintf(fp, "window rules applied: %lu\n", stats.rules_applied);
+    fprintf(fp, "stacking order pushes: %lu\n", stats.restacks);
+    fprintf(fp, "focus boosts: %lu applied, %lu deferred, %lu failed\n",
+            stats.boosts, stats.boosts_deferred, stats.boost_failures);
+    fprintf(fp, "hidden processes: %lu frozen, %lu thawed, %lu failed, ~%.1f s CPU saved\n",
+            stats.freezes, stats.thaws, stats.freeze_failures, stats.freeze_saved_ms / 1e3);
+    fprintf(fp, "overview thumbnails rendered: %lu\n", stats.thumbnails);
+    fprintf(fp, "launcher path directories read: %lu\n", stats.path_rescans);
+    fprintf(fp, "wallpaper loaded in %lu ms%s\n", stats.wallpaper_ms,
+            stats.wallpaper_cached ? " from the cache" : "");
+    fprintf(fp, "shared snapshots published: %lu\n", stats.snapshots);
+    fprintf(fp, "ipc records coalesced: %lu, dropped: %lu\n",
+            stats.ipc_coalesced, stats.ipc_dropped);
+    fprintf(fp, "worker jobs: %lu done, %lu inline, latency avg %.1f us max %lu us, "
+            "max queue depth %lu\n", stats.jobs_done, stats.jobs_inline,
+            stats.jobs_done ? (double)stats.job_latency_us / stats.jobs_done : 0.0,
+            stats.job_latency_max_us, stats.job_queue_max);
+    print_pings(fp);
+    print_resources(fp);
+}
+
+/* Only what the enabled features consume: crossings for focus-follows-mouse,
+ * property changes for titles the bar, the overview filter, the snapshot
+ * or focus records show.  Unmap and destroy arrive through the root's
+ * SubstructureNotify. */
+long client_event_mask(void) {
+    long mask = NoEventMask;
+    
+    if (config.focus_mouse) {
+        mask |= EnterWindowMask;
+    }
+    if (bar_window() || overview_enabled() || snapshot_enabled() || ipc_enabled()) {
+        mask |= PropertyChangeMask;
     }
-    return xcolor.pixel;
+    return mask;
 }
 
-void setup(void) {
-    XSetWindowAttributes wa;
+/* Reselect on every client after a feature was turned on or off */
+void update_event_masks(void) {
+    long mask = client_event_mask();
     
+    if (mask == client_mask) {
+        return;
+    }
+    client_mask = mask;
+    for (Client *c = mon->clients; c; c = c->next) {
+        be->select_input(c->win, mask);
+    }
+}
+
+/* Every _NET atom swm interns is one it handles, except the type name */
+static void set_net_supported(void) {
+    Atom supported[NetLast];
+    int n = 0;
+    
+    for (int i = 0; i < NetLast; i++) {
+        if (i != NetUTF8String) {
+            supported[n++] = netatom[i];
+        }
+    }
+    be->change_property(root, netatom[NetSupported], XA_ATOM, 32,
+                        PropModeReplace, (unsigned char *)supported, n);
+}
+
+/* After startup: a window can be destroyed between the event swm acts on
+ * and the request it sends, e.g. a ping round or a focus change, and a
+ * client can be gone before XKillClient reaches it.  Errors about such
+ * windows are expected; anything else is still fatal. */
+static int xerror(Display *d, XErrorEvent *ee) {
+    if (ee->error_code == BadWindow || ee->error_code == BadMatch ||
+        ee->error_code == BadDrawable ||
+        (ee->request_code == X_KillClient && ee->error_code == BadValue)) {
+        stats.x_errors_ignored++;
+        return 0;
+    }
+    return xerror_default(d, ee);
+}
+
+void setup(void) {
     /* Open display */
-    if (!(dpy = XOpenDisplay(NULL))) {
+    if (!be->open()) {
         die("Cannot open display");
     }
     
-    screen = DefaultScreen(dpy);
-    root = RootWindow(dpy, screen);
-    screen_width = DisplayWidth(dpy, screen);
-    screen_height = DisplayHeight(dpy, screen);
-    
     /* Initialize atoms */
-    wm_protocols = XInternAtom(dpy, "WM_PROTOCOLS", False);
-    wm_delete_window = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
-    net_system_tray_opcode = XInternAtom(dpy, "_NET_SYSTEM_TRAY_OPCODE", False);
-    net_system_tray_orientation = XInternAtom(dpy, "_NET_SYSTEM_TRAY_ORIENTATION_HORZ", False);
+    net_system_tray_opcode = be->intern_atom("_NET_SYSTEM_TRAY_OPCODE");
+    net_system_tray_orientation = be->intern_atom("_NET_SYSTEM_TRAY_ORIENTATION_HORZ");
     char tray_atom_name[32];
     snprintf(tray_atom_name, sizeof(tray_atom_name), "_NET_SYSTEM_TRAY_S%d", screen);
-    net_system_tray_selection = XInternAtom(dpy, tray_atom_name, False);
-    xembed_info = XInternAtom(dpy, "_XEMBED_INFO", False);
+    net_system_tray_selection = be->intern_atom(tray_atom_name);
+    xembed_info = be->intern_atom("_XEMBED_INFO");
+    wmatom[WMState] = be->intern_atom("WM_STATE");
+    wmatom[WMProtocols] = be->intern_atom("WM_PROTOCOLS");
+    wmatom[WMDelete] = be->intern_atom("WM_DELETE_WINDOW");
+    netatom[NetSupported] = be->intern_atom("_NET_SUPPORTED");
+    netatom[NetWMName] = be->intern_atom("_NET_WM_NAME");
+    netatom[NetUTF8String] = be->intern_atom("UTF8_STRING");
+    netatom[NetWMState] = be->intern_atom("_NET_WM_STATE");
+    netatom[NetWMStateHidden] = be->intern_atom("_NET_WM_STATE_HIDDEN");
+    netatom[NetWMStateFullscreen] = be->intern_atom("_NET_WM_STATE_FULLSCREEN");
+    netatom[NetWMStateAbove] = be->intern_atom("_NET_WM_STATE_ABOVE");
+    netatom[NetWMWindowType] = be->intern_atom("_NET_WM_WINDOW_TYPE");
+    netatom[NetWMWindowTypeDesktop] = be->intern_atom("_NET_WM_WINDOW_TYPE_DESKTOP");
+    netatom[NetWMWindowTypeDialog] = be->intern_atom("_NET_WM_WINDOW_TYPE_DIALOG");
+    netatom[NetWMWindowTypeUtility] = be->intern_atom("_NET_WM_WINDOW_TYPE_UTILITY");
+    netatom[NetWMWindowTypeSplash] = be->intern_atom("_NET_WM_WINDOW_TYPE_SPLASH");
+    netatom[NetWMPid] = be->intern_atom("_NET_WM_PID");
+    netatom[NetWMPing] = be->intern_atom("_NET_WM_PING");
     
     /* Check if another WM is running */
-    XSetErrorHandler(NULL);
-    XSelectInput(dpy, root, SubstructureRedirectMask);
-    XSync(dpy, False);
+    if (dpy) {
+        XSetErrorHandler(NULL);
+    }
+    be->select_input(root, SubstructureRedirectMask);
+    be->sync();
+    if (dpy) {
+        xerror_default = XSetErrorHandler(xerror);
+    }
     
     /* Set up event mask for root window */
-    wa.event_mask = SubstructureRedirectMask | SubstructureNotifyMask |
-                    ButtonPressMask | PointerMotionMask | EnterWindowMask |
-                    LeaveWindowMask | StructureNotifyMask | PropertyChangeMask;
-    XChangeWindowAttributes(dpy, root, CWEventMask, &wa);
-    XSelectInput(dpy, root, wa.event_mask);
+    be->select_input(root, ROOT_EVENT_MASK);
+    set_net_supported();
+    started_ns = now_ns();
     
     /* Initialize configuration */
     config.border_width = BORDER_WIDTH;
     config.border_normal = get_color(BORDER_NORMAL);
     config.border_focus = get_color(BORDER_FOCUS);
+    config.border_unresponsive = get_color(BORDER_UNRESPONSIVE);
     config.master_factor = MASTER_FACTOR;
     config.num_master = NUM_MASTER;
+    config.hide_strategy = HIDE_STRATEGY;
+    config.focus_mouse = FOCUS_FOLLOWS_MOUSE;
+    config.overview = OVERVIEW;
+    config.focus_boost = FOCUS_BOOST;
+    config.boost_weight = BOOST_WEIGHT;
+    config.boost_nice = BOOST_NICE;
+    config.freeze_grace = FREEZE_GRACE;
+    config.throttle_percent = THROTTLE_PERCENT;
+    config.resource_interval = RESOURCE_INTERVAL;
+    config.ping_interval = PING_INTERVAL;
+    config.ping_timeout = PING_TIMEOUT;
+    config.kill_timeout = KILL_TIMEOUT;
+    config.font = FONT;
+    config.wallpaper = WALLPAPER;
+    config.show_bar = SHOW_BAR;
+    config.bar_fg = get_color(BAR_FG);
+    config.bar_bg = get_color(BAR_BG);
+    config.modules = modules;
+    config.num_modules = sizeof(modules) / sizeof(modules[0]);
+    config.rules = rules;
+    config.num_rules = sizeof(rules) / sizeof(rules[0]);
+    compile_rules();
+    config.workers = WORKERS;
     config.keys = keys;
     config.num_keys = sizeof(keys) / sizeof(keys[0]);
     config.layouts = layouts;
@@ -112,24 +267,62 @@ void setup(void) {
     mon->num_master = config.num_master;
     mon->layout = &config.layouts[0];
     
+    /* SIGUSR1 stays blocked in the workers started next */
+    create_resources();
+    
+    /* Background threads for everything that does not need X */
+    start_workers(config.workers);
+    create_ping();
+    
     /* Grab keys */
     grab_keys();
     
     /* Initialize system tray */
     tray = create_tray();
     
-    /* Scan for existing windows */
-    scan();
+    /* Status bar next to the tray */
+    create_bar();
+    create_overview();
+    create_launcher();
+    create_wallpaper();
+    
+    /* State for external bars and scripts */
+    create_snapshot();
+    create_ipc();
+    update_event_masks();
     
     printf("SWM initialized successfully\n");
 }
 
 void cleanup(void) {
-    /* Clean up clients */
+#ifdef DEBUG
+    print_stats(stderr);
+#endif
+    
+    /* Bring back anything parked off-screen, then clean up clients */
+    for (Client *c = mon->clients; c; c = c->next) {
+        show_client(c);
+    }
     while (mon->clients) {
         remove_client(mon->clients);
     }
     
+    /* Workers may still hold bar module state */
+    stop_workers();
+    end_boost();
+    thaw_all();
+    destroy_resources();
+    destroy_ping();
+    destroy_bar();
+    destroy_launcher();
+    destroy_wallpaper();
+    destroy_overview();
+    free_stack();
+    destroy_snapshot();
+    destroy_ipc();
+    trace_cleanup();
+    free_rules();
+    
     /* Clean up tray */
     if (tray) {
         destroy_tray(tray);
@@ -139,24 +332,25 @@ void cleanup(void) {
     free(mon);
     
     /* Close display */
-    XCloseDisplay(dpy);
+    be->close();
 }
 
 void scan(void) {
     unsigned int num;
-    Window d1, d2, *wins = NULL;
+    Window *wins = NULL;
     XWindowAttributes wa;
     
-    if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
+    if (be->query_tree(root, &wins, &num)) {
         for (unsigned int i = 0; i < num; i++) {
-            if (!XGetWindowAttributes(dpy, wins[i], &wa) ||
-                wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1)) {
+            if (!be->get_attributes(wins[i], &wa) ||
+                wa.override_redirect) {
                 continue;
             }
             if (wa.map_state == IsViewable || wa.map_state == IsUnmapped) {
                 Client *c = create_client(wins[i]);
                 if (c) {
                     attach_client(c);
+                    record_adopted(wins[i]);
                 }
             }
         }
@@ -167,13 +361,131 @@ void scan(void) {
     apply_layout();
 }
 
+void handle_event(XEvent *ev) {
+    /* Damage reports and input while the overview or launcher is open */
+    if (overview_event(ev) || launcher_event(ev)) {
+        return;
+    }
+    if (ev->type < LASTEvent && event_handlers[ev->type]) {
+        trace_begin(event_name(ev->type), "event");
+        event_handlers[ev->type](ev);
+        trace_end();
+    }
+}
+
+void watch_fd(int fd, short events, WatchFunc func) {
+    for (int i = 0; i < num_watches; i++) {
+        if (watches[i].fd == fd) {
+            watches[i].events = events;
+            watches[i].func = func;
+            return;
+        }
+    }
+    if (num_watches == MAX_WATCHES) {
+        die("Too many watched file descriptors");
+    }
+    watches[num_watches].fd = fd;
+    watches[num_watches].events = events;
+    watches[num_watches].func = func;
+    num_watches++;
+}
+
+void unwatch_fd(int fd) {
+    for (int i = 0; i < num_watches; i++) {
+        if (watches[i].fd == fd) {
+            watches[i] = watches[--num_watches];
+            return;
+        }
+    }
+}
+
+void arm_deadline(Deadline *d, long long at) {
+    struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+    
+    if (d->fd < 0) {
+        if ((d->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+            return;
+        }
+        watch_fd(d->fd, POLLIN, d->func);
+    }
+    if (d->at && d->at <= at) {
+        return;
+    }
+    d->at = at;
+    its.it_value.tv_sec = at / 1000000000;
+    its.it_value.tv_nsec = at % 1000000000;
+    timerfd_settime(d->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* From the deadline's callback: false for a spurious wakeup, else it is
+ * disarmed and can be armed again */
+bool deadline_expired(Deadline *d) {
+    uint64_t expirations;
+    
+    if (read(d->fd, &expirations, sizeof(expirations)) < 0) {
+        return false;
+    }
+    d->at = 0;
+    return true;
+}
+
+void stop_deadline(Deadline *d) {
+    if (d->fd >= 0) {
+        unwatch_fd(d->fd);
+        close(d->fd);
+        d->fd = -1;
+    }
+    d->at = 0;
+}
+
 void run(void) {
     XEvent ev;
-    
-    /* Main event loop */
-    while (running && !XNextEvent(dpy, &ev)) {
-        if (event_handlers[ev.type]) {
-            event_handlers[ev.type](&ev);
+    struct pollfd fds[1 + MAX_WATCHES];
+    
+    /* Main event loop: drain X events, then sleep on the X connection and
+     * every watched descriptor */
+    while (running) {
+        while (running && XPending(dpy)) {
+            XNextEvent(dpy, &ev);
+            stats.events++;
+            record_event(&ev);
+            handle_event(&ev);
+        }
+        if (!running) {
+            break;
+        }
+        update_stack();
+        update_snapshot();
+        update_ipc();
+        update_bar();
+        record_flush();
+        XFlush(dpy);
+        
+        int n = num_watches;
+        fds[0].fd = ConnectionNumber(dpy);
+        fds[0].events = POLLIN;
+        for (int i = 0; i < n; i++) {
+            fds[i + 1].fd = watches[i].fd;
+            fds[i + 1].events = watches[i].events;
+        }
+        if (poll(fds, n + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            die("poll failed");
+        }
+        stats.wakeups++;
+        /* Callbacks may add or remove watches; walk the snapshot by fd */
+        for (int i = 0; i < n; i++) {
+            if (!fds[i + 1].revents) {
+                continue;
+            }
+            for (int j = 0; j < num_watches; j++) {
+                if (watches[j].fd == fds[i + 1].fd) {
+                    watches[j].func(fds[i + 1].fd, fds[i + 1].revents);
+                    break;
+                }
+            }
         }
     }
 }
@@ -182,7 +494,26 @@ void run(void) {
 void on_configure_request(XEvent *e) {
     XConfigureRequestEvent *ev = &e->xconfigurerequest;
     XWindowChanges wc;
+    Client *c = find_client(ev->window);
     
+    if (c) {
+        /* Tiled and fullscreen geometry belongs to swm: answer with where
+         * the window already is instead of moving it */
+        if (c->is_fullscreen ||
+            (!c->is_floating && mon->layout->apply != floating_layout)) {
+            stats.configure_rejected++;
+            configure_client(c);
+            return;
+        }
+        resize_client(c,
+            (ev->value_mask & CWX) ? ev->x : c->x,
+            (ev->value_mask & CWY) ? ev->y : c->y,
+            (ev->value_mask & CWWidth) ? ev->width : c->w,
+            (ev->value_mask & CWHeight) ? ev->height : c->h);
+        return;
+    }
+    
+    /* Unmanaged windows get exactly what they asked for */
     wc.x = ev->x;
     wc.y = ev->y;
     wc.width = ev->width;
@@ -190,52 +521,69 @@ void on_configure_request(XEvent *e) {
     wc.border_width = ev->border_width;
     wc.sibling = ev->above;
     wc.stack_mode = ev->detail;
-    XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
-    XSync(dpy, False);
+    be->configure(ev->window, ev->value_mask, &wc);
 }
 
 void on_map_request(XEvent *e) {
     XMapRequestEvent *ev = &e->xmaprequest;
     XWindowAttributes wa;
     
-    if (!XGetWindowAttributes(dpy, ev->window, &wa) || wa.override_redirect) {
+    if (!be->get_attributes(ev->window, &wa) || wa.override_redirect) {
         return;
     }
     
     /* Check if it's a tray icon */
     Atom actual_type;
     int actual_format;
-    unsigned long nitems, bytes_after;
+    unsigned long nitems;
     unsigned char *data = NULL;
     
-    if (XGetWindowProperty(dpy, ev->window, xembed_info, 0, 2, False,
-                          xembed_info, &actual_type, &actual_format,
-                          &nitems, &bytes_after, &data) == Success && data) {
+    if (be->get_property(ev->window, xembed_info, xembed_info, 2,
+                         &actual_type, &actual_format,
+                         &nitems, &data) == Success && data) {
         XFree(data);
         add_tray_client(ev->window);
         return;
     }
     
-    /* Create and manage the client */
+    /* Create and manage the client; a dialog or other floating window
+     * opens over the tiled set without changing it */
     Client *c = create_client(ev->window);
     if (c) {
         attach_client(c);
-        XMapWindow(dpy, ev->window);
+        show_client(c);
         focus_client(c);
+        if (!c->is_floating && !c->is_fullscreen) {
+            apply_layout();
+        }
+    }
+}
+
+/* Likewise closing one, unless focus falls back to a window the layout
+ * is hiding */
+static void unmanage(Client *c) {
+    bool tiled = !c->is_floating && !c->is_fullscreen && !c->is_iconic;
+    
+    remove_client(c);
+    if (tiled || (mon->selected && mon->selected->is_hidden)) {
         apply_layout();
     }
 }
 
 void on_unmap_notify(XEvent *e) {
     XUnmapEvent *ev = &e->xunmap;
-    Client *c;
-    
-    /* Find client */
-    for (c = mon->clients; c && c->win != ev->window; c = c->next);
+    Client *c = find_client(ev->window);
     
     if (c) {
-        remove_client(c);
-        apply_layout();
+        /* Act on the root's copy only, and not on our own hide_client() */
+        if (ev->event != root) {
+            return;
+        }
+        if (c->ignore_unmap > 0) {
+            c->ignore_unmap--;
+            return;
+        }
+        unmanage(c);
     } else {
         /* Check if it's a tray client */
         remove_tray_client(ev->window);
@@ -244,14 +592,11 @@ void on_unmap_notify(XEvent *e) {
 
 void on_destroy_notify(XEvent *e) {
     XDestroyWindowEvent *ev = &e->xdestroywindow;
-    Client *c;
-    
-    /* Find client */
-    for (c = mon->clients; c && c->win != ev->window; c = c->next);
+    Client *c = find_client(ev->window);
     
     if (c) {
-        remove_client(c);
-        apply_layout();
+        c->destroyed = true;
+        unmanage(c);
     } else {
         /* Check if it's a tray client */
         remove_tray_client(ev->window);
@@ -267,15 +612,14 @@ void on_enter_notify(XEvent *e) {
     }
     
     /* Find client and focus it */
-    for (c = mon->clients; c && c->win != ev->window; c = c->next);
-    if (c) {
+    if (config.focus_mouse && (c = find_client(ev->window))) {
         focus_client(c);
     }
 }
 
 void on_key_press(XEvent *e) {
     XKeyEvent *ev = &e->xkey;
-    KeySym keysym = XLookupKeysym(ev, 0);
+    KeySym keysym = be->lookup_keysym(ev);
     
     for (int i = 0; i < config.num_keys; i++) {
         if (keysym == config.keys[i].keysym &&
@@ -287,12 +631,16 @@ void on_key_press(XEvent *e) {
     }
 }
 
+/* Only seen while focus_mru holds the keyboard */
+void on_key_release(XEvent *e) {
+    if (IsModifierKey(be->lookup_keysym(&e->xkey))) {
+        end_focus_cycle();
+    }
+}
+
 void on_button_press(XEvent *e) {
     XButtonPressedEvent *ev = &e->xbutton;
-    Client *c;
-    
-    /* Find client */
-    for (c = mon->clients; c && c->win != ev->window; c = c->next);
+    Client *c = find_client(ev->window);
     
     if (c) {
         focus_client(c);
@@ -301,6 +649,20 @@ void on_button_press(XEvent *e) {
 
 void on_client_message(XEvent *e) {
     XClientMessageEvent *ev = &e->xclient;
+    Client *c;
+    
+    if (ev->message_type == wmatom[WMProtocols] &&
+        (Atom)ev->data.l[0] == netatom[NetWMPing]) {
+        ping_reply(ev);
+        return;
+    }
+    
+    /* Up to two properties per request; an unused one is 0 */
+    if (ev->message_type == netatom[NetWMState] && (c = find_client(ev->window))) {
+        change_net_wm_state(c, ev->data.l[0], (Atom)ev->data.l[1]);
+        change_net_wm_state(c, ev->data.l[0], (Atom)ev->data.l[2]);
+        return;
+    }
     
     /* Handle system tray messages */
     if (ev->message_type == net_system_tray_opcode) {
@@ -310,9 +672,29 @@ void on_client_message(XEvent *e) {
     }
 }
 
-int main(void) {
-    setup();
-    run();
-    cleanup();
-    return EXIT_SUCCESS;
+/* X cannot select PropertyNotify per atom, so drop everything swm has no
+ * use for before looking anything up */
+static bool wanted_property(Atom atom) {
+    return atom == XA_WM_NAME || atom == netatom[NetWMName];
+}
+
+void on_property_notify(XEvent *e) {
+    XPropertyEvent *ev = &e->xproperty;
+    Client *c;
+    
+    if (ev->state == PropertyDelete || !wanted_property(ev->atom)) {
+        stats.properties_ignored++;
+        return;
+    }
+    if ((c = find_client(ev->window))) {
+        update_title(c);
+    }
+}
+
+void on_expose(XEvent *e) {
+    XExposeEvent *ev = &e->xexpose;
+    
+    if (ev->count == 0) {
+        expose_bar(ev->window);
+    }
 }
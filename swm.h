@@ -9,6 +9,7 @@
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 /* Forward declarations */
 typedef struct Client Client;
@@ -16,14 +17,85 @@ typedef struct Monitor Monitor;
 typedef struct KeyBinding KeyBinding;
 typedef struct TilingLayout TilingLayout;
 typedef struct Config Config;
+typedef struct SplitNode SplitNode;
+typedef struct Thumbnail Thumbnail;
+
+/* How a client is kept out of sight when a layout does not show it */
+typedef enum {
+    HideDefault,        /* client: use the layout's, layout: use config's */
+    HideUnmap,          /* unmap it; frees the client's surfaces */
+    HideOffscreen,      /* keep it mapped but parked outside the screen */
+} HideStrategy;
+
+/* What happens to a process while all its windows are hidden */
+typedef enum {
+    FreezeNone,
+    FreezePause,        /* cgroup freezer, or SIGSTOP without a cgroup */
+    FreezeThrottle,     /* cpu.max quota; needs the process's own cgroup */
+} FreezePolicy;
+
+/* Atoms shared between modules */
+enum { WMState, WMProtocols, WMDelete, WMLast };
+enum { NetSupported, NetWMName, NetUTF8String, NetWMState, NetWMStateHidden,
+       NetWMStateFullscreen, NetWMStateAbove, NetWMWindowType,
+       NetWMWindowTypeDesktop, NetWMWindowTypeDialog, NetWMWindowTypeUtility,
+       NetWMWindowTypeSplash, NetWMPid, NetWMPing, NetLast };
+
+/* Server resources held by a window's client, from X-Resource */
+typedef struct {
+    unsigned long count;
+    unsigned long pixmap_bytes;
+    unsigned long first_pixmap_bytes;   /* at the first sample */
+    unsigned long samples;
+} ResourceUsage;
+
+/* _NET_WM_PING round trips of a client */
+typedef struct {
+    unsigned long serial;       /* timestamp of the ping in flight, 0 if none */
+    long long sent_ns;
+    unsigned long last_us;      /* round trip of the latest answer */
+    unsigned long max_us;
+    unsigned long answered;
+    bool unresponsive;          /* in flight for longer than PING_TIMEOUT */
+} PingState;
 
 /* Client (Window) structure */
 struct Client {
     Window win;
     int x, y, w, h;
     int old_x, old_y, old_w, old_h;
+    char name[256];
+    int bw, old_bw;
     bool is_floating;
-    bool is_fullscreen;
+    bool is_fullscreen;         /* borderless, above the tray, out of layout */
+    bool is_above;              /* _NET_WM_STATE_ABOVE, over other windows */
+    bool is_iconic;             /* hidden on request, out of layout */
+    unsigned long fullscreen_pass;  /* mon->passes when it went fullscreen */
+    bool is_hidden;
+    bool is_desktop;            /* _NET_WM_WINDOW_TYPE_DESKTOP, stacked lowest */
+    Window transient_for;       /* WM_TRANSIENT_FOR, stacked above it */
+    Client *stack_parent;       /* transient_for resolved, per stacking pass */
+    Client *transients;         /* its transients, most recently focused first */
+    Client *next_transient;
+    int layer;
+    pid_t pid;                  /* owning process on this host, 0 if unknown */
+    FreezePolicy freeze;        /* from rules */
+    long long hidden_ns;        /* when hide_client() last hid it */
+    long long hidden_usage_us;  /* the process's CPU time at that point */
+    ResourceUsage res;
+    bool can_delete;            /* WM_PROTOCOLS lists WM_DELETE_WINDOW */
+    bool can_ping;              /* and _NET_WM_PING */
+    PingState ping;
+    long long kill_ns;          /* last kill_client(), to escalate a repeat */
+    HideStrategy hide;          /* per-client override */
+    HideStrategy hidden_by;     /* strategy used while is_hidden */
+    int ignore_unmap;           /* UnmapNotify events we caused ourselves */
+    bool to_stack;              /* attach at the end of the stack */
+    SplitNode *leaf;            /* place in the monitor's split tree */
+    Thumbnail *thumb;           /* cached overview picture */
+    bool redirected;            /* contents kept offscreen for the overview */
+    bool destroyed;             /* DestroyNotify seen, nothing left to free */
+    Client *mru_next, *mru_prev;  /* focus history, most recent first */
     Client *next;
     Client *prev;
 };
@@ -35,6 +107,7 @@ typedef void (*LayoutFunc)(Monitor *m);
 struct TilingLayout {
     const char *name;
     LayoutFunc apply;
+    HideStrategy hide;
 };
 
 /* Monitor (workspace) structure */
@@ -45,6 +118,13 @@ struct Monitor {
     TilingLayout *layout;
     float master_factor;
     int num_master;
+    SplitNode *tree;            /* persistent split tree for bsp/spiral/dwindle */
+    SplitNode *tree_last;       /* most recently inserted leaf */
+    SplitNode *split_at;        /* leaf bsp splits next, the focused one */
+    bool tree_stale;            /* windows were moved by another layout */
+    Client *mru, *mru_tail;     /* focus history: last focused, least recent */
+    Client *cycle;              /* candidate while cycling with focus_mru */
+    unsigned long passes;       /* apply_layout() calls so far */
 };
 
 /* Key binding structure */
@@ -59,6 +139,7 @@ struct KeyBinding {
 typedef struct TrayClient {
     Window win;
     int x, y, w, h;
+    ResourceUsage res;
     struct TrayClient *next;
 } TrayClient;
 
@@ -69,14 +150,163 @@ typedef struct {
     TrayClient *clients;
 } SystemTray;
 
+/* A property read with get_property, requested ahead of time */
+typedef struct {
+    Atom prop;
+    Atom type;
+    long length;
+} PropertyRequest;
+
+/* Display backend: the X requests swm makes, so the window management
+ * logic can also run against the in-memory mock */
+typedef struct {
+    const char *name;
+    Bool (*open)(void);
+    void (*close)(void);
+    Bool (*get_attributes)(Window win, XWindowAttributes *wa);
+    void (*select_input)(Window win, long mask);
+    void (*move_resize)(Window win, int x, int y, int width, int height);
+    void (*configure)(Window win, unsigned int mask, XWindowChanges *wc);
+    void (*map)(Window win);
+    void (*unmap)(Window win);
+    void (*raise)(Window win);
+    void (*restack)(Window *wins, int n);   /* top to bottom */
+    void (*set_border_width)(Window win, unsigned int width);
+    void (*set_border)(Window win, unsigned long pixel);
+    void (*set_focus)(Window win);
+    int (*get_property)(Window win, Atom prop, Atom type, long length,
+                        Atom *actual_type, int *format,
+                        unsigned long *nitems, unsigned char **data);
+    /* Sends the requests together; the get_property calls that match them
+     * then take their replies.  n == 0 drops replies left unread. */
+    void (*prefetch_properties)(Window win, const PropertyRequest *req, int n);
+    void (*change_property)(Window win, Atom prop, Atom type, int format,
+                            int mode, const unsigned char *data, int n);
+    void (*send_event)(Window win, long mask, XEvent *ev);
+    Atom (*intern_atom)(const char *name);
+    Window (*create_window)(Window parent, int x, int y, int width, int height,
+                            unsigned long mask, XSetWindowAttributes *wa);
+    void (*destroy_window)(Window win);
+    void (*reparent)(Window win, Window parent, int x, int y);
+    Window (*get_selection_owner)(Atom selection);
+    void (*set_selection_owner)(Atom selection, Window owner);
+    Bool (*query_tree)(Window win, Window **children, unsigned int *n);
+    void (*grab_key)(KeySym keysym, unsigned int mod);
+    void (*ungrab_keys)(void);
+    Bool (*grab_keyboard)(void);    /* False unless a modifier is still held */
+    void (*ungrab_keyboard)(void);
+    KeySym (*lookup_keysym)(XKeyEvent *ev);
+    void (*kill)(Window win);
+    pid_t (*client_pid)(Window win);    /* via X-Resource, 0 if unknown */
+    Bool (*client_resources)(Window win, unsigned long *count,
+                             unsigned long *pixmap_bytes);
+    unsigned long (*alloc_color)(const char *name);
+    void (*sync)(void);
+    unsigned long (*requests)(void);
+    void (*report)(FILE *fp);
+} Backend;
+
+/* Status bar module: fills buf with its text */
+typedef struct {
+    void (*func)(const char *arg, char *buf, size_t size);
+    const char *arg;
+    int interval;           /* seconds between updates, 0 for none */
+    const char *watch;      /* file whose changes trigger an update */
+} BarModule;
+
+/* Window rule: NULL match fields match anything, title is a substring */
+typedef struct {
+    const char *class;
+    const char *instance;
+    const char *title;
+    const char *role;
+    int floating;           /* 1: floats, 0: tiles, -1: default */
+    int fullscreen;         /* 1: fullscreen, 0: never, -1: as requested */
+    int master;             /* 1: becomes master, 0: end of stack, -1: default */
+    HideStrategy hide;
+    int border_width;       /* -1 keeps BORDER_WIDTH */
+    FreezePolicy freeze;
+} Rule;
+
+/* Main loop callback for a watched file descriptor */
+typedef void (*WatchFunc)(int fd, short revents);
+
+/* An absolute CLOCK_MONOTONIC deadline on a timerfd the main loop
+ * watches; arming it again only ever moves it earlier */
+typedef struct {
+    int fd;                     /* -1 until first armed */
+    long long at;               /* 0 when not armed */
+    WatchFunc func;
+} Deadline;
+
+/* Worker pool job step */
+typedef void (*JobFunc)(void *arg);
+
+/* Runtime counters */
+typedef struct {
+    unsigned long configure_rejected;
+    unsigned long bar_redraws;
+    unsigned long rules_applied;
+    unsigned long jobs_done;
+    unsigned long jobs_inline;          /* run on the X thread, pool absent or full */
+    unsigned long long job_latency_us;  /* submit to done, summed */
+    unsigned long job_latency_max_us;
+    unsigned long job_queue_max;
+    unsigned long restacks;
+    unsigned long boosts;               /* focused processes given more CPU */
+    unsigned long boosts_deferred;      /* focus changes inside the rate limit */
+    unsigned long boost_failures;       /* no own cgroup and nice not permitted */
+    unsigned long freezes;              /* processes paused or throttled */
+    unsigned long thaws;
+    unsigned long freeze_failures;
+    unsigned long long freeze_saved_ms; /* estimated CPU time not spent */
+    unsigned long resource_queries;     /* X-Resource samples of a client */
+    unsigned long pings;
+    unsigned long pings_timed_out;      /* clients marked unresponsive */
+    unsigned long kills_forced;         /* repeated kills of a hung client */
+    unsigned long x_errors_ignored;     /* requests on windows gone meanwhile */
+    unsigned long path_rescans;         /* $PATH directories read by the launcher */
+    unsigned long thumbnails;           /* overview thumbnails re-rendered */
+    unsigned long wallpaper_ms;         /* decoding and scaling, or the cache read */
+    unsigned long wallpaper_cached;     /* 1 if it came from the cache */
+    unsigned long snapshots;            /* shared snapshot updates published */
+    unsigned long ipc_coalesced;        /* state records merged for slow readers */
+    unsigned long ipc_dropped;          /* map/unmap records lost to full queues */
+    unsigned long wakeups;              /* poll() returns in the main loop */
+    unsigned long events;
+    unsigned long properties_ignored;   /* PropertyNotify for atoms swm ignores */
+} Stats;
+
 /* Configuration structure */
 struct Config {
     const char *font;
+    const char *wallpaper;  /* image file, NULL leaves the root alone */
     unsigned int border_width;
     unsigned long border_normal;
     unsigned long border_focus;
+    unsigned long border_unresponsive;
     float master_factor;
     int num_master;
+    HideStrategy hide_strategy;
+    bool focus_mouse;
+    bool overview;
+    bool focus_boost;
+    int boost_weight;
+    int boost_nice;
+    int freeze_grace;       /* seconds */
+    int throttle_percent;
+    int resource_interval;  /* seconds between X-Resource samples */
+    int ping_interval;      /* seconds, 0 pings only on kill_client */
+    int ping_timeout;       /* milliseconds */
+    int kill_timeout;       /* seconds */
+    bool show_bar;
+    unsigned long bar_fg;
+    unsigned long bar_bg;
+    const BarModule *modules;
+    int num_modules;
+    const Rule *rules;
+    int num_rules;
+    int workers;
     KeyBinding *keys;
     int num_keys;
     TilingLayout *layouts;
@@ -85,6 +315,9 @@ struct Config {
 
 /* Global variables */
 extern Display *dpy;
+extern const Backend *be;
+extern const Backend xlib_backend;
+extern const Backend mock_backend;
 extern Window root;
 extern Monitor *mon;
 extern Config config;
@@ -92,12 +325,25 @@ extern SystemTray *tray;
 extern int screen;
 extern int screen_width, screen_height;
 extern bool running;
+extern Stats stats;
+extern Atom wmatom[WMLast];
+extern Atom netatom[NetLast];
 
 /* Core functions */
 void setup(void);
 void cleanup(void);
 void run(void);
 void scan(void);
+void handle_event(XEvent *ev);
+void watch_fd(int fd, short events, WatchFunc func);
+void unwatch_fd(int fd);
+long long now_ns(void);
+void arm_deadline(Deadline *d, long long at);
+bool deadline_expired(Deadline *d);
+void stop_deadline(Deadline *d);
+void print_stats(FILE *fp);
+long client_event_mask(void);
+void update_event_masks(void);
 
 /* Event handlers */
 void on_configure_request(XEvent *e);
@@ -106,11 +352,15 @@ void on_unmap_notify(XEvent *e);
 void on_destroy_notify(XEvent *e);
 void on_enter_notify(XEvent *e);
 void on_key_press(XEvent *e);
+void on_key_release(XEvent *e);
 void on_button_press(XEvent *e);
 void on_client_message(XEvent *e);
+void on_property_notify(XEvent *e);
+void on_expose(XEvent *e);
 
 /* Client management */
 Client* create_client(Window w);
+Client* find_client(Window w);
 void attach_client(Client *c);
 void detach_client(Client *c);
 void focus_client(Client *c);
@@ -119,6 +369,12 @@ void configure_client(Client *c);
 void resize_client(Client *c, int x, int y, int w, int h);
 void show_client(Client *c);
 void hide_client(Client *c);
+void update_net_wm_state(Client *c);
+void update_border(Client *c);
+void set_fullscreen(Client *c, bool fullscreen);
+void set_iconic(Client *c, bool iconic);
+void change_net_wm_state(Client *c, long action, Atom state);
+void update_title(Client *c);
 
 /* Layout functions */
 void tile_layout(Monitor *m);
@@ -128,6 +384,15 @@ void grid_layout(Monitor *m);
 void apply_layout(void);
 void set_layout(const char *arg);
 
+/* Split tree layouts */
+void bsp_layout(Monitor *m);
+void spiral_layout(Monitor *m);
+void dwindle_layout(Monitor *m);
+bool is_tree_layout(const TilingLayout *l);
+bool tree_resize(Client *c, float delta);
+void tree_remove(Client *c);
+void tree_focus(Client *c);
+
 /* Key bindings */
 void grab_keys(void);
 void spawn(const char *arg);
@@ -135,8 +400,11 @@ void quit_wm(const char *arg);
 void kill_client(const char *arg);
 void toggle_floating(const char *arg);
 void toggle_fullscreen(const char *arg);
+void toggle_focus_mouse(const char *arg);
 void focus_next(const char *arg);
 void focus_prev(const char *arg);
+void focus_mru(const char *arg);
+void end_focus_cycle(void);
 void set_master_factor(const char *arg);
 void inc_num_master(const char *arg);
 void dec_num_master(const char *arg);
@@ -148,6 +416,114 @@ void add_tray_client(Window w);
 void remove_tray_client(Window w);
 void update_tray_layout(void);
 
+/* Focus CPU boost */
+void boost_focus(Client *c);
+void end_boost(void);
+bool cgroup_dir(pid_t pid, char *dir, size_t size);
+bool cgroup_read(const char *dir, const char *file, char *buf, size_t size);
+bool cgroup_write(const char *dir, const char *file, const char *value);
+
+/* X resource accounting */
+void create_resources(void);
+void destroy_resources(void);
+void update_resources(void);
+void print_resources(FILE *fp);
+
+/* Hung client detection */
+void create_ping(void);
+void destroy_ping(void);
+void ping_client(Client *c);
+void ping_reply(XClientMessageEvent *ev);
+bool kill_pending(Client *c);
+void cancel_ping(Client *c);
+void print_pings(FILE *fp);
+
+/* Hidden window freezing */
+void freeze_hidden(Client *c);
+void thaw_client(Client *c);
+bool client_frozen(Client *c);
+void thaw_all(void);
+
+/* Application launcher */
+void create_launcher(void);
+void destroy_launcher(void);
+void launcher(const char *arg);
+bool launcher_event(XEvent *ev);
+
+/* Wallpaper */
+void create_wallpaper(void);
+void destroy_wallpaper(void);
+
+/* Window overview */
+void create_overview(void);
+void destroy_overview(void);
+void overview(const char *arg);
+bool overview_event(XEvent *ev);
+void overview_unfocus(Client *c);
+void overview_redirect(Client *c);
+void overview_forget(Client *c);
+bool overview_enabled(void);
+
+/* Event subscription socket */
+void create_ipc(void);
+void update_ipc(void);
+void ipc_window(bool mapped, Window win);
+bool ipc_enabled(void);
+void destroy_ipc(void);
+
+/* Shared state snapshot */
+void create_snapshot(void);
+void update_snapshot(void);
+bool snapshot_enabled(void);
+void destroy_snapshot(void);
+
+/* Stacking order */
+void stack_changed(void);
+void update_stack(void);
+void free_stack(void);
+
+/* Worker pool */
+void start_workers(int n);
+void stop_workers(void);
+void queue_job(JobFunc work, JobFunc done, void *arg);
+bool job_cancelled(void);
+
+/* Window rules */
+void compile_rules(void);
+void apply_rules(Client *c);
+int rule_properties(PropertyRequest *req);
+void free_rules(void);
+
+/* Status bar */
+void create_bar(void);
+void destroy_bar(void);
+void update_bar(void);
+void expose_bar(Window w);
+Window bar_window(void);
+void status_clock(const char *arg, char *buf, size_t size);
+void status_load(const char *arg, char *buf, size_t size);
+void status_mem(const char *arg, char *buf, size_t size);
+void status_file(const char *arg, char *buf, size_t size);
+
+/* Mock backend */
+Window mock_add_window(int x, int y, int w, int h, bool override_redirect);
+void mock_set_keysym(KeyCode code, KeySym keysym);
+
+/* Event recording and replay */
+void record_start(const char *path);
+void record_event(const XEvent *ev);
+void record_adopted(Window w);
+void record_flush(void);
+void record_stop(void);
+void replay(const char *path);
+const char *event_name(int type);
+
+/* Timeline tracing */
+void trace_init(const char *path);
+void trace_begin(const char *name, const char *cat);
+void trace_end(void);
+void trace_cleanup(void);
+
 /* Utility functions */
 unsigned long get_color(const char *color);
 void die(const char *errstr);
@@ -0,0 +1,172 @@
+/*
+ * Timeline Tracing
+ *
+ * Records spans (event handler dispatch, layout passes, focus changes,
+ * key grabs, tray updates and blocking round trips) into a preallocated
+ * ring buffer and writes them out as Chrome Trace Event JSON, which
+ * chrome://tracing and ui.perfetto.dev both open.  Every span carries
+ * the X request sequence number it started at and how many requests it
+ * issued.  SIGUSR2 toggles tracing; turning it off writes the file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include "swm.h"
+
+/* About 3 MB; the oldest spans are overwritten first */
+#define TRACE_EVENTS    65536
+#define TRACE_DEPTH     32
+
+typedef struct {
+    const char *name;
+    const char *cat;
+    long long start_ns;
+    long long dur_ns;
+    unsigned long seq;
+    unsigned long requests;
+    int depth;
+} Span;
+
+static Span *ring;
+static unsigned long ring_next;
+static Span stack[TRACE_DEPTH];
+static int depth;
+static bool tracing;
+static int signal_fd = -1;
+static char trace_path[256];
+static long long origin_ns;
+
+void trace_begin(const char *name, const char *cat) {
+    if (!tracing) {
+        return;
+    }
+    if (depth < TRACE_DEPTH) {
+        stack[depth].name = name;
+        stack[depth].cat = cat;
+        stack[depth].seq = be->requests();
+        stack[depth].start_ns = now_ns();
+    }
+    depth++;
+}
+
+void trace_end(void) {
+    Span *s;
+
+    if (!tracing || !depth) {
+        return;
+    }
+    if (--depth >= TRACE_DEPTH) {
+        return;
+    }
+    s = &ring[ring_next++ % TRACE_EVENTS];
+    *s = stack[depth];
+    s->dur_ns = now_ns() - s->start_ns;
+    s->requests = be->requests() - s->seq;
+    s->depth = depth;
+}
+
+static void write_trace(void) {
+    unsigned long first = ring_next > TRACE_EVENTS ? ring_next - TRACE_EVENTS : 0;
+    int pid = getpid();
+    struct stat st;
+    FILE *fp = NULL;
+    int fd;
+
+    /* Never through a symlink, nor into a file someone else planted */
+    fd = open(trace_path, O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != getuid() ||
+                    ftruncate(fd, 0) < 0 || !(fp = fdopen(fd, "w")))) {
+        close(fd);
+    }
+    if (!fp) {
+        fprintf(stderr, "swm: cannot write trace to %s\n", trace_path);
+        return;
+    }
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+            "\"args\": {\"name\": \"swm\"}}", pid);
+    for (unsigned long i = first; i < ring_next; i++) {
+        Span *s = &ring[i % TRACE_EVENTS];
+        fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": 1, "
+                "\"args\": {\"seq\": %lu, \"requests\": %lu, \"depth\": %d}}",
+                s->name, s->cat, (s->start_ns - origin_ns) / 1e3,
+                s->dur_ns / 1e3, pid, s->seq, s->requests, s->depth);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    fprintf(stderr, "swm: wrote %lu trace spans to %s\n", ring_next - first, trace_path);
+}
+
+static void trace_start(void) {
+    if (!ring && !(ring = malloc(TRACE_EVENTS * sizeof(Span)))) {
+        return;
+    }
+    ring_next = 0;
+    depth = 0;
+    origin_ns = now_ns();
+    tracing = true;
+}
+
+static void trace_stop(void) {
+    if (!tracing) {
+        return;
+    }
+    tracing = false;
+    write_trace();
+}
+
+static void on_signal(int fd, short revents) {
+    struct signalfd_siginfo si;
+
+    (void)revents;
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        if (tracing) {
+            trace_stop();
+        } else {
+            trace_start();
+        }
+    }
+}
+
+/* Called before any thread starts so they all inherit the blocked signal.
+ * A path starts tracing right away; without one SIGUSR2 writes to
+ * $XDG_RUNTIME_DIR, or /tmp when it is not set. */
+void trace_init(const char *path) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    sigset_t mask;
+
+    if (path) {
+        snprintf(trace_path, sizeof(trace_path), "%s", path);
+        trace_start();
+    } else {
+        snprintf(trace_path, sizeof(trace_path), "%s/swm-%d.trace.json",
+                 dir && dir[0] ? dir : "/tmp", (int)getpid());
+    }
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == 0 &&
+        (signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) >= 0) {
+        watch_fd(signal_fd, POLLIN, on_signal);
+    }
+}
+
+void trace_cleanup(void) {
+    trace_stop();
+    if (signal_fd >= 0) {
+        unwatch_fd(signal_fd);
+        close(signal_fd);
+        signal_fd = -1;
+    }
+    free(ring);
+    ring = NULL;
+}
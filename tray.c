@@ -27,9 +27,9 @@ SystemTray* create_tray(void) {
     
     /* Check if another tray is running */
     snprintf(tray_atom_name, sizeof(tray_atom_name), "_NET_SYSTEM_TRAY_S%d", screen);
-    net_system_tray_s = XInternAtom(dpy, tray_atom_name, False);
+    net_system_tray_s = be->intern_atom(tray_atom_name);
     
-    if (XGetSelectionOwner(dpy, net_system_tray_s) != None) {
+    if (be->get_selection_owner(net_system_tray_s) != None) {
         fprintf(stderr, "swm: another system tray is running\n");
         return NULL;
     }
@@ -46,24 +46,21 @@ SystemTray* create_tray(void) {
     wa.event_mask = ButtonPressMask | ExposureMask;
     wa.background_pixel = get_color("#000000");
     
-    t->win = XCreateWindow(dpy, root, t->x, t->y, t->w, t->h, 0,
-                          DefaultDepth(dpy, screen),
-                          CopyFromParent,
-                          DefaultVisual(dpy, screen),
-                          CWOverrideRedirect | CWBackPixel | CWEventMask,
-                          &wa);
+    t->win = be->create_window(root, t->x, t->y, t->w, t->h,
+                               CWOverrideRedirect | CWBackPixel | CWEventMask,
+                               &wa);
     
     /* Set up atoms */
-    net_system_tray_opcode = XInternAtom(dpy, "_NET_SYSTEM_TRAY_OPCODE", False);
-    xembed = XInternAtom(dpy, "_XEMBED", False);
-    xembed_info = XInternAtom(dpy, "_XEMBED_INFO", False);
+    net_system_tray_opcode = be->intern_atom("_NET_SYSTEM_TRAY_OPCODE");
+    xembed = be->intern_atom("_XEMBED");
+    xembed_info = be->intern_atom("_XEMBED_INFO");
     
     /* Claim selection */
-    XSetSelectionOwner(dpy, net_system_tray_s, t->win, CurrentTime);
+    be->set_selection_owner(net_system_tray_s, t->win);
     
-    if (XGetSelectionOwner(dpy, net_system_tray_s) != t->win) {
+    if (be->get_selection_owner(net_system_tray_s) != t->win) {
         fprintf(stderr, "swm: could not acquire system tray selection\n");
-        XDestroyWindow(dpy, t->win);
+        be->destroy_window(t->win);
         free(t);
         return NULL;
     }
@@ -72,25 +69,24 @@ SystemTray* create_tray(void) {
     XClientMessageEvent ev;
     ev.type = ClientMessage;
     ev.window = root;
-    ev.message_type = XInternAtom(dpy, "MANAGER", False);
+    ev.message_type = be->intern_atom("MANAGER");
     ev.format = 32;
     ev.data.l[0] = CurrentTime;
     ev.data.l[1] = net_system_tray_s;
     ev.data.l[2] = t->win;
     ev.data.l[3] = 0;
     ev.data.l[4] = 0;
-    XSendEvent(dpy, root, False, StructureNotifyMask, (XEvent *)&ev);
+    be->send_event(root, StructureNotifyMask, (XEvent *)&ev);
     
     /* Set orientation */
-    Atom orientation = XInternAtom(dpy, "_NET_SYSTEM_TRAY_ORIENTATION_HORZ", False);
     unsigned long orient_horz = 0;
-    XChangeProperty(dpy, t->win,
-                   XInternAtom(dpy, "_NET_SYSTEM_TRAY_ORIENTATION", False),
-                   XA_CARDINAL, 32, PropModeReplace,
-                   (unsigned char *)&orient_horz, 1);
+    be->change_property(t->win, be->intern_atom("_NET_SYSTEM_TRAY_ORIENTATION"),
+                        XA_CARDINAL, 32, PropModeReplace,
+                        (unsigned char *)&orient_horz, 1);
     
-    XMapRaised(dpy, t->win);
-    XSync(dpy, False);
+    be->map(t->win);
+    stack_changed();
+    be->sync();
     
     return t;
 }
@@ -103,16 +99,16 @@ void destroy_tray(SystemTray *t) {
     /* Remove all tray clients */
     while (t->clients) {
         TrayClient *next = t->clients->next;
-        XUnmapWindow(dpy, t->clients->win);
-        XReparentWindow(dpy, t->clients->win, root, 0, 0);
+        be->unmap(t->clients->win);
+        be->reparent(t->clients->win, root, 0, 0);
         free(t->clients);
         t->clients = next;
     }
     
     /* Release selection */
-    XSetSelectionOwner(dpy, net_system_tray_s, None, CurrentTime);
+    be->set_selection_owner(net_system_tray_s, None);
     
-    XDestroyWindow(dpy, t->win);
+    be->destroy_window(t->win);
     free(t);
 }
 
@@ -130,10 +126,12 @@ void add_tray_client(Window w) {
         return;
     }
     
-    if (!XGetWindowAttributes(dpy, w, &wa)) {
+    if (!be->get_attributes(w, &wa)) {
         return;
     }
     
+    trace_begin("add_tray_client", "tray");
+    
     /* Create tray client */
     tc = calloc(1, sizeof(TrayClient));
     tc->win = w;
@@ -143,8 +141,10 @@ void add_tray_client(Window w) {
     tray->clients = tc;
     
     /* Embed the icon */
-    XSelectInput(dpy, w, StructureNotifyMask | PropertyChangeMask);
-    XReparentWindow(dpy, w, tray->win, 0, 0);
+    /* Icons are children of the tray window, so their unmap and destroy
+     * notifications do not reach the root */
+    be->select_input(w, StructureNotifyMask);
+    be->reparent(w, tray->win, 0, 0);
     
     /* Send XEMBED message */
     XClientMessageEvent ev;
@@ -157,10 +157,12 @@ void add_tray_client(Window w) {
     ev.data.l[2] = 0;
     ev.data.l[3] = tray->win;
     ev.data.l[4] = 0;
-    XSendEvent(dpy, w, False, NoEventMask, (XEvent *)&ev);
+    be->send_event(w, NoEventMask, (XEvent *)&ev);
     
-    XMapRaised(dpy, w);
+    be->map(w);
+    be->raise(w);
     update_tray_layout();
+    trace_end();
 }
 
 void remove_tray_client(Window w) {
@@ -179,8 +181,8 @@ void remove_tray_client(Window w) {
     tc = *ptc;
     *ptc = tc->next;
     
-    XUnmapWindow(dpy, tc->win);
-    XReparentWindow(dpy, tc->win, root, 0, 0);
+    be->unmap(tc->win);
+    be->reparent(tc->win, root, 0, 0);
     free(tc);
     
     update_tray_layout();
@@ -194,13 +196,16 @@ void update_tray_layout(void) {
         return;
     }
     
+    trace_begin("update_tray_layout", "tray");
+    
     /* Layout tray icons horizontally */
     for (tc = tray->clients; tc; tc = tc->next) {
         tc->x = x;
         tc->y = 0;
-        XMoveResizeWindow(dpy, tc->win, tc->x, tc->y, tc->w, tc->h);
+        be->move_resize(tc->win, tc->x, tc->y, tc->w, tc->h);
         x += tc->w + 2;
     }
     
-    XSync(dpy, False);
+    be->sync();
+    trace_end();
 }
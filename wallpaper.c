@@ -0,0 +1,504 @@
+/*
+ * Wallpaper
+ *
+ * Loads WALLPAPER (binary PPM or farbfeld, and PNG when built with
+ * PNG=1), scales it to cover the screen and uploads it through MIT-SHM
+ * into a single root pixmap.  The pixmap is published as _XROOTPMAP_ID
+ * and ESETROOT_PMAP_ID for pseudo-transparent terminals and belongs to a
+ * second connection kept with RetainPermanent, so it outlives a restart;
+ * the next setter frees it with XKillClient, as the Esetroot convention
+ * has it.  Decoding and scaling run on a worker, straight into the shared
+ * segment.  The scaled pixels are cached under ~/.cache/swm keyed by the
+ * image and the resolution, so later logins only read them back.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XShm.h>
+#ifdef PNG
+#include <png.h>
+#endif
+#include "swm.h"
+
+#define CACHE_MAGIC     "swmwall1"
+#define IMAGE_MAX       (1 << 28)   /* pixels; larger files are refused */
+
+typedef struct {
+    char path[1024];
+    char cache[1024];
+    int w, h;                   /* of the screen */
+    XImage *image;              /* written by the worker */
+    XShmSegmentInfo shm;        /* shmid -1 without MIT-SHM */
+    bool ok, cached;
+    long long ns;
+} Load;
+
+static Display *owner;          /* its pixmap outlives swm */
+static bool shm_failed;
+
+/* ~/.cache/swm/wallpaper-WxH-<hash of path, size and mtime> */
+static bool cache_path(Load *l, char *dir, size_t size) {
+    const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    unsigned long long hash = 14695981039346656037ULL;
+    struct stat st;
+
+    if (stat(l->path, &st) < 0) {
+        return false;
+    }
+    if (xdg && xdg[0]) {
+        snprintf(dir, size, "%s/swm", xdg);
+    } else if (home) {
+        snprintf(dir, size, "%s/.cache/swm", home);
+    } else {
+        return false;
+    }
+    for (const char *p = l->path; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    hash = (hash ^ (unsigned long long)st.st_size) * 1099511628211ULL;
+    hash = (hash ^ (unsigned long long)st.st_mtime) * 1099511628211ULL;
+    snprintf(l->cache, sizeof(l->cache), "%s/wallpaper-%dx%d-%016llx",
+             dir, l->w, l->h, hash);
+    return true;
+}
+
+static bool read_cache(Load *l) {
+    char magic[8];
+    uint32_t size[2];
+    size_t bytes = (size_t)l->image->bytes_per_line * l->h;
+    FILE *fp = fopen(l->cache, "rb");
+    bool ok;
+
+    if (!fp) {
+        return false;
+    }
+    ok = fread(magic, 1, 8, fp) == 8 && !memcmp(magic, CACHE_MAGIC, 8) &&
+         fread(size, sizeof(uint32_t), 2, fp) == 2 &&
+         size[0] == (uint32_t)l->w && size[1] == (uint32_t)l->h &&
+         fread(l->image->data, 1, bytes, fp) == bytes;
+    fclose(fp);
+    return ok;
+}
+
+/* Written whole under a temporary name, so a crash never leaves half */
+static void write_cache(Load *l, const char *dir) {
+    uint32_t size[2] = { l->w, l->h };
+    size_t bytes = (size_t)l->image->bytes_per_line * l->h;
+    char parent[1024], tmp[1100];
+    FILE *fp;
+
+    snprintf(parent, sizeof(parent), "%s", dir);
+    *strrchr(parent, '/') = '\0';
+    mkdir(parent, 0700);
+    mkdir(dir, 0700);
+    snprintf(tmp, sizeof(tmp), "%s.%d", l->cache, (int)getpid());
+    if (!(fp = fopen(tmp, "wb"))) {
+        return;
+    }
+    if (fwrite(CACHE_MAGIC, 1, 8, fp) == 8 && fwrite(size, sizeof(uint32_t), 2, fp) == 2 &&
+        fwrite(l->image->data, 1, bytes, fp) == bytes && fclose(fp) == 0) {
+        rename(tmp, l->cache);
+        return;
+    }
+    unlink(tmp);
+}
+
+/* Whitespace and comments between the fields of a PPM header */
+static int ppm_number(FILE *fp) {
+    int ch, n = 0;
+
+    while ((ch = fgetc(fp)) == '#' || (ch > 0 && strchr(" \t\r\n", ch))) {
+        if (ch == '#') {
+            while ((ch = fgetc(fp)) != '\n' && ch != EOF);
+        }
+    }
+    if (ch < '0' || ch > '9') {
+        return -1;
+    }
+    for (; ch >= '0' && ch <= '9'; ch = fgetc(fp)) {
+        n = n * 10 + ch - '0';
+        if (n > IMAGE_MAX) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+static unsigned char *load_ppm(FILE *fp, int *w, int *h) {
+    int max;
+    size_t n;
+    unsigned char *rgb;
+
+    *w = ppm_number(fp);
+    *h = ppm_number(fp);
+    max = ppm_number(fp);
+    if (*w <= 0 || *h <= 0 || (long long)*w * *h > IMAGE_MAX || max <= 0 || max > 65535) {
+        return NULL;
+    }
+    n = (size_t)*w * *h * 3;
+    if (!(rgb = malloc(n))) {
+        return NULL;
+    }
+    if (max < 256) {
+        if (fread(rgb, 1, n, fp) != n) {
+            free(rgb);
+            return NULL;
+        }
+        for (size_t i = 0; max != 255 && i < n; i++) {
+            rgb[i] = rgb[i] * 255 / max;
+        }
+        return rgb;
+    }
+    /* Two bytes per sample, most significant first */
+    for (size_t i = 0; i < n; i++) {
+        int hi = fgetc(fp), lo = fgetc(fp);
+        if (lo == EOF) {
+            free(rgb);
+            return NULL;
+        }
+        rgb[i] = (hi << 8 | lo) * 255 / max;
+    }
+    return rgb;
+}
+
+/* 16-bit big-endian RGBA; alpha is blended over black */
+static unsigned char *load_farbfeld(FILE *fp, int *w, int *h) {
+    unsigned char head[8], px[8], *rgb;
+    size_t n;
+
+    if (fread(head, 1, 8, fp) != 8) {
+        return NULL;
+    }
+    *w = (int)((uint32_t)head[0] << 24 | head[1] << 16 | head[2] << 8 | head[3]);
+    *h = (int)((uint32_t)head[4] << 24 | head[5] << 16 | head[6] << 8 | head[7]);
+    if (*w <= 0 || *h <= 0 || (long long)*w * *h > IMAGE_MAX) {
+        return NULL;
+    }
+    n = (size_t)*w * *h;
+    if (!(rgb = malloc(n * 3))) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fread(px, 1, 8, fp) != 8) {
+            free(rgb);
+            return NULL;
+        }
+        unsigned long a = px[6] << 8 | px[7];
+        for (int c = 0; c < 3; c++) {
+            rgb[i * 3 + c] = (px[c * 2] << 8 | px[c * 2 + 1]) * a / 65535 / 257;
+        }
+    }
+    return rgb;
+}
+
+#ifdef PNG
+static unsigned char *load_png(const char *path, int *w, int *h) {
+    png_image png;
+    unsigned char *rgb = NULL;
+
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path)) {
+        return NULL;
+    }
+    png.format = PNG_FORMAT_RGB;
+    *w = png.width;
+    *h = png.height;
+    if ((long long)*w * *h > IMAGE_MAX || !(rgb = malloc(PNG_IMAGE_SIZE(png))) ||
+        !png_image_finish_read(&png, NULL, rgb, 0, NULL)) {
+        png_image_free(&png);
+        free(rgb);
+        return NULL;
+    }
+    return rgb;
+}
+#endif
+
+static unsigned char *load_image(const char *path, int *w, int *h) {
+    unsigned char magic[8], *rgb = NULL;
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        return NULL;
+    }
+    if (fread(magic, 1, 8, fp) == 8) {
+        if (magic[0] == 'P' && magic[1] == '6') {
+            fseek(fp, 2, SEEK_SET);
+            rgb = load_ppm(fp, w, h);
+        } else if (!memcmp(magic, "farbfeld", 8)) {
+            rgb = load_farbfeld(fp, w, h);
+#ifdef PNG
+        } else if (!memcmp(magic, "\x89PNG", 4)) {
+            rgb = load_png(path, w, h);
+#endif
+        }
+    }
+    fclose(fp);
+    return rgb;
+}
+
+/* Bilinear, covering the whole output and cropping the centered excess */
+static void scale(const unsigned char *rgb, int sw, int sh, XImage *out) {
+    int dw = out->width, dh = out->height;
+    double s = (double)dw / sw > (double)dh / sh ? (double)dw / sw : (double)dh / sh;
+    double ox = (sw - dw / s) / 2, oy = (sh - dh / s) / 2;
+    int *x0 = malloc(dw * sizeof(int)), *wx = malloc(dw * sizeof(int));
+
+    if (!x0 || !wx) {
+        free(x0);
+        free(wx);
+        return;
+    }
+    for (int x = 0; x < dw; x++) {
+        double fx = (x + 0.5) / s + ox - 0.5;
+        fx = fx < 0 ? 0 : fx > sw - 1 ? sw - 1 : fx;
+        x0[x] = (int)fx;
+        wx[x] = (int)((fx - x0[x]) * 256);
+    }
+    for (int y = 0; y < dh; y++) {
+        double fy = (y + 0.5) / s + oy - 0.5;
+        fy = fy < 0 ? 0 : fy > sh - 1 ? sh - 1 : fy;
+        int y0 = (int)fy, y1 = y0 + 1 < sh ? y0 + 1 : y0, wy = (int)((fy - y0) * 256);
+        const unsigned char *top = rgb + (size_t)y0 * sw * 3, *bot = rgb + (size_t)y1 * sw * 3;
+        uint32_t *row = (uint32_t *)(out->data + (size_t)y * out->bytes_per_line);
+
+        for (int x = 0; x < dw; x++) {
+            int a = x0[x] * 3, b = (x0[x] + 1 < sw ? x0[x] + 1 : x0[x]) * 3;
+            uint32_t px = 0;
+            for (int c = 0; c < 3; c++) {
+                int t = top[a + c] * (256 - wx[x]) + top[b + c] * wx[x];
+                int u = bot[a + c] * (256 - wx[x]) + bot[b + c] * wx[x];
+                px = px << 8 | (uint32_t)((t * (256 - wy) + u * wy) >> 16);
+            }
+            row[x] = px;
+        }
+    }
+    free(x0);
+    free(wx);
+}
+
+/* Worker: no X here, only the pixels behind the image */
+static void load_work(void *arg) {
+    Load *l = arg;
+    long long start = now_ns();
+    char dir[900];
+    bool cacheable = cache_path(l, dir, sizeof(dir));
+    unsigned char *rgb;
+    int w, h;
+
+    if (cacheable && read_cache(l)) {
+        l->ok = l->cached = true;
+    } else if ((rgb = load_image(l->path, &w, &h))) {
+        scale(rgb, w, h, l->image);
+        free(rgb);
+        l->ok = true;
+        if (cacheable) {
+            write_cache(l, dir);
+        }
+    }
+    l->ns = now_ns() - start;
+}
+
+static void free_load(Load *l) {
+    if (l->shm.shmid >= 0) {
+        XShmDetach(owner, &l->shm);
+        XSync(owner, False);
+        shmdt(l->shm.shmaddr);
+        l->image->data = NULL;
+    }
+    if (l->image) {
+        XDestroyImage(l->image);
+    }
+    free(l);
+}
+
+/* Resources of the previous setter, if it followed the same convention */
+static int kill_error(Display *d, XErrorEvent *ee) {
+    (void)d;
+    (void)ee;
+    return 0;
+}
+
+static void free_old(Window r, Atom xrootpmap, Atom esetroot) {
+    int (*old)(Display *, XErrorEvent *);
+    Atom type;
+    int format;
+    unsigned long n, after;
+    unsigned char *a = NULL, *b = NULL;
+
+    if (XGetWindowProperty(owner, r, xrootpmap, 0, 1, False, XA_PIXMAP, &type, &format,
+                           &n, &after, &a) == Success && a && n == 1 &&
+        XGetWindowProperty(owner, r, esetroot, 0, 1, False, XA_PIXMAP, &type, &format,
+                           &n, &after, &b) == Success && b && n == 1 &&
+        *(Pixmap *)a == *(Pixmap *)b) {
+        /* The ID may be stale, and BadValue must not reach swm's handler */
+        old = XSetErrorHandler(kill_error);
+        XKillClient(owner, *(Pixmap *)a);
+        XSync(owner, False);
+        XSetErrorHandler(old);
+    }
+    if (a) {
+        XFree(a);
+    }
+    if (b) {
+        XFree(b);
+    }
+}
+
+static void load_done(void *arg) {
+    Load *l = arg;
+    int scr = DefaultScreen(owner);
+    Window r = RootWindow(owner, scr);
+    Atom xrootpmap = XInternAtom(owner, "_XROOTPMAP_ID", False);
+    Atom esetroot = XInternAtom(owner, "ESETROOT_PMAP_ID", False);
+    Pixmap pixmap;
+    GC gc;
+
+    if (job_cancelled() || !l->ok) {
+        if (!job_cancelled()) {
+            fprintf(stderr, "swm: cannot load wallpaper %s\n", l->path);
+        }
+        free_load(l);
+        XCloseDisplay(owner);
+        owner = NULL;
+        return;
+    }
+    trace_begin("wallpaper", "wallpaper");
+    pixmap = XCreatePixmap(owner, r, l->w, l->h, DefaultDepth(owner, scr));
+    gc = XCreateGC(owner, pixmap, 0, NULL);
+    if (l->shm.shmid >= 0) {
+        XShmPutImage(owner, pixmap, gc, l->image, 0, 0, 0, 0, l->w, l->h, False);
+    } else {
+        XPutImage(owner, pixmap, gc, l->image, 0, 0, 0, 0, l->w, l->h);
+    }
+    XFreeGC(owner, gc);
+    free_old(r, xrootpmap, esetroot);
+    XChangeProperty(owner, r, xrootpmap, XA_PIXMAP, 32, PropModeReplace,
+                    (unsigned char *)&pixmap, 1);
+    XChangeProperty(owner, r, esetroot, XA_PIXMAP, 32, PropModeReplace,
+                    (unsigned char *)&pixmap, 1);
+    XSetWindowBackgroundPixmap(owner, r, pixmap);
+    XClearWindow(owner, r);
+    XSetCloseDownMode(owner, RetainPermanent);
+    stats.wallpaper_ms = l->ns / 1000000;
+    stats.wallpaper_cached = l->cached;
+    free_load(l);
+    XCloseDisplay(owner);
+    owner = NULL;
+    trace_end();
+}
+
+static int shm_error(Display *d, XErrorEvent *ee) {
+    (void)d;
+    (void)ee;
+    shm_failed = true;
+    return 0;
+}
+
+/* Shared memory needs the server on this machine; anything else gets a
+ * plain XPutImage, which Xlib splits into requests of allowed size */
+static XImage *create_shm_image(Load *l, Visual *visual, int depth) {
+    const char *name = DisplayString(owner);
+    int (*old)(Display *, XErrorEvent *);
+    XImage *image;
+
+    if ((name[0] != ':' && strncmp(name, "unix:", 5)) || !XShmQueryExtension(owner) ||
+        !(image = XShmCreateImage(owner, visual, depth, ZPixmap, NULL, &l->shm, l->w, l->h))) {
+        return NULL;
+    }
+    l->shm.shmid = shmget(IPC_PRIVATE, (size_t)image->bytes_per_line * l->h, IPC_CREAT | 0600);
+    if (l->shm.shmid < 0) {
+        XDestroyImage(image);
+        return NULL;
+    }
+    l->shm.shmaddr = image->data = shmat(l->shm.shmid, NULL, 0);
+    l->shm.readOnly = True;
+    shm_failed = false;
+    old = XSetErrorHandler(shm_error);
+    if (l->shm.shmaddr != (char *)-1) {
+        XShmAttach(owner, &l->shm);
+        XSync(owner, False);
+    }
+    XSetErrorHandler(old);
+    /* Gone once both sides have detached */
+    shmctl(l->shm.shmid, IPC_RMID, NULL);
+    if (l->shm.shmaddr == (char *)-1 || shm_failed) {
+        if (l->shm.shmaddr != (char *)-1) {
+            shmdt(l->shm.shmaddr);
+        }
+        image->data = NULL;
+        XDestroyImage(image);
+        l->shm.shmid = -1;
+        return NULL;
+    }
+    return image;
+}
+
+void create_wallpaper(void) {
+    const char *home = getenv("HOME");
+    Visual *visual;
+    int depth;
+    Load *l;
+
+    if (!dpy || !config.wallpaper) {
+        return;
+    }
+    /* The worker writes 0xRRGGBB words */
+    visual = DefaultVisual(dpy, screen);
+    depth = DefaultDepth(dpy, screen);
+    if (visual->class != TrueColor || visual->red_mask != 0xff0000 ||
+        visual->green_mask != 0xff00 || visual->blue_mask != 0xff || depth < 24) {
+        fprintf(stderr, "swm: wallpaper needs a 24-bit TrueColor visual\n");
+        return;
+    }
+    if (!(owner = XOpenDisplay(DisplayString(dpy)))) {
+        return;
+    }
+    fcntl(ConnectionNumber(owner), F_SETFD, FD_CLOEXEC);
+
+    l = calloc(1, sizeof(Load));
+    if (config.wallpaper[0] == '~' && home) {
+        snprintf(l->path, sizeof(l->path), "%s%s", home, config.wallpaper + 1);
+    } else {
+        snprintf(l->path, sizeof(l->path), "%s", config.wallpaper);
+    }
+    l->w = screen_width;
+    l->h = screen_height;
+    l->shm.shmid = -1;
+    if (!(l->image = create_shm_image(l, visual, depth))) {
+        l->image = XCreateImage(owner, visual, depth, ZPixmap, 0, NULL, l->w, l->h, 32, 0);
+        if (l->image) {
+            l->image->data = malloc((size_t)l->image->bytes_per_line * l->h);
+            /* Pixels are written in this machine's byte order */
+            l->image->byte_order = *(const char *)&(int){ 1 } ? LSBFirst : MSBFirst;
+        }
+    }
+    if (!l->image || !l->image->data || l->image->bits_per_pixel != 32) {
+        fprintf(stderr, "swm: wallpaper needs 32 bits per pixel\n");
+        free_load(l);
+        XCloseDisplay(owner);
+        owner = NULL;
+        return;
+    }
+    queue_job(load_work, load_done, l);
+}
+
+/* After stop_workers(), which already dropped a load still in flight */
+void destroy_wallpaper(void) {
+    if (owner) {
+        XCloseDisplay(owner);
+        owner = NULL;
+    }
+}
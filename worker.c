@@ -0,0 +1,223 @@
+/*
+ * Worker Pool
+ *
+ * Runs work that does not need the X connection (launching processes,
+ * reading /proc and files, computing status text) on a few background
+ * threads so it can never stall event handling.  Jobs are handed out
+ * through a small mutex-protected queue; each worker returns finished
+ * jobs through its own single-producer/single-consumer ring and pokes an
+ * eventfd that the main loop watches.  The done callbacks run on the
+ * main thread, which is the only one allowed to touch dpy.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "swm.h"
+
+/* Jobs in flight at once, queued, running or waiting to be collected.
+ * Bounding this keeps every result ring from ever filling up. */
+#define JOB_MAX         64
+
+typedef struct {
+    JobFunc work;
+    JobFunc done;
+    void *arg;
+    long long submitted;
+} Job;
+
+/* Written by one worker, read by the main thread */
+typedef struct {
+    Job slots[JOB_MAX];
+    unsigned int head;          /* next slot to read, owned by the main thread */
+    unsigned int tail;          /* next slot to write, owned by the worker */
+} Ring;
+
+typedef struct {
+    pthread_t thread;
+    Ring results;
+} Worker;
+
+static Worker *workers;
+static int num_workers;
+static int event_fd = -1;
+static int in_flight;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static Job queue[JOB_MAX];
+static int queue_head, queue_len;
+static bool stopping;
+static bool cancelled;
+
+static long long now_us(void) {
+    return now_ns() / 1000;
+}
+
+static void ring_push(Ring *r, const Job *job) {
+    unsigned int tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+
+    r->slots[tail % JOB_MAX] = *job;
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static bool ring_pop(Ring *r, Job *job) {
+    unsigned int head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+    if (head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *job = r->slots[head % JOB_MAX];
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    uint64_t one = 1;
+    Job job;
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (!queue_len && !stopping) {
+            pthread_cond_wait(&wake, &lock);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+        job = queue[queue_head];
+        queue_head = (queue_head + 1) % JOB_MAX;
+        queue_len--;
+        pthread_mutex_unlock(&lock);
+
+        job.work(job.arg);
+
+        /* Publish the result, then wake the main loop */
+        ring_push(&w->results, &job);
+        if (write(event_fd, &one, sizeof(one)) < 0) {
+            continue;
+        }
+    }
+}
+
+/* Main thread: collect finished jobs and run their done callbacks */
+static void on_results(int fd, short revents) {
+    uint64_t count;
+    Job job;
+
+    (void)revents;
+    if (read(fd, &count, sizeof(count)) < 0) {
+        return;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        while (ring_pop(&workers[i].results, &job)) {
+            long long latency = now_us() - job.submitted;
+
+            in_flight--;
+            stats.jobs_done++;
+            stats.job_latency_us += latency;
+            if (latency > (long long)stats.job_latency_max_us) {
+                stats.job_latency_max_us = latency;
+            }
+            if (job.done) {
+                job.done(job.arg);
+            }
+        }
+    }
+}
+
+void start_workers(int n) {
+    if (n <= 0) {
+        return;
+    }
+    if ((event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        return;
+    }
+    workers = calloc(n, sizeof(Worker));
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            break;
+        }
+        num_workers++;
+    }
+    watch_fd(event_fd, POLLIN, on_results);
+}
+
+/* Jobs still queued or uncollected are dropped, but their done callbacks
+ * still run, with job_cancelled() true, so they can free their arguments */
+void stop_workers(void) {
+    Job dropped[JOB_MAX];
+    int num_dropped = 0;
+
+    if (!num_workers) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    unwatch_fd(event_fd);
+    close(event_fd);
+    event_fd = -1;
+    for (int i = 0; i < num_workers; i++) {
+        while (ring_pop(&workers[i].results, &dropped[num_dropped])) {
+            num_dropped++;
+        }
+    }
+    for (; queue_len; queue_len--) {
+        dropped[num_dropped++] = queue[queue_head];
+        queue_head = (queue_head + 1) % JOB_MAX;
+    }
+    free(workers);
+    workers = NULL;
+    num_workers = 0;
+    in_flight = 0;
+
+    cancelled = true;
+    for (int i = 0; i < num_dropped; i++) {
+        if (dropped[i].done) {
+            dropped[i].done(dropped[i].arg);
+        }
+    }
+    cancelled = false;
+}
+
+/* Inside a done callback: the job is being dropped by stop_workers(), and
+ * its work may not have run */
+bool job_cancelled(void) {
+    return cancelled;
+}
+
+/* Run work on a worker and done on the main thread once it finishes.
+ * Without workers, or with the pool saturated, both run right here. */
+void queue_job(JobFunc work, JobFunc done, void *arg) {
+    if (!num_workers || in_flight == JOB_MAX) {
+        stats.jobs_inline++;
+        work(arg);
+        if (done) {
+            done(arg);
+        }
+        return;
+    }
+
+    Job job = { work, done, arg, now_us() };
+
+    in_flight++;
+    pthread_mutex_lock(&lock);
+    queue[(queue_head + queue_len) % JOB_MAX] = job;
+    queue_len++;
+    if ((unsigned long)queue_len > stats.job_queue_max) {
+        stats.job_queue_max = queue_len;
+    }
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}